@@ -1,9 +1,7 @@
 ﻿# include <Siv3D.hpp> // OpenSiv3D v0.1.5
 
+#include <vector>
 #include <functional>
-#include <shared_mutex>
-#include <thread>
-#include <future>
 
 #include "entity_component_system/entity_component_system.hpp"
 
@@ -11,26 +9,14 @@ namespace ecs = entity_component_system;
 
 namespace {
 
-template <class T>
-class thread_safe : public T {
-public:
-	using T::T;
-
-	using mutex_type = std::shared_mutex;
-
-	mutex_type &mutex() { return _mutex; }
-
-private:
-	mutex_type _mutex;
-};
-
-using lock_guard = std::lock_guard<std::shared_mutex>;
-using shared_lock = std::shared_lock<std::shared_mutex>;
+template <typename... Args>
+using system = ecs::system<Args...>;
 
+// 描画で読むシステムは二重化し、描画側は publish() で公開された表を読む
 template <typename... Args>
-using system = thread_safe<ecs::system<Args...>>;
+using buffered_system = ecs::buffered_system<Args...>;
 
-using circle_system = system<Circle>;
+using circle_system = buffered_system<Circle>;
 
 struct circle_component {
 	enum index : size_t {
@@ -39,7 +25,7 @@ struct circle_component {
 	};
 };
 
-using color_system = system<HSV>;
+using color_system = buffered_system<HSV>;
 
 struct color_component {
 	enum index : size_t {
@@ -90,14 +76,14 @@ struct life_component {
 	};
 };
 
-using World = thread_safe<ecs::world<
+using World = ecs::world<
 	circle_system,
 	color_system,
 	move_system,
 	color_transition_system,
 	life_transition_system,
 	gravity_system
->>;
+>;
 
 enum world_system : size_t {
 	circle,
@@ -109,55 +95,51 @@ enum world_system : size_t {
 };
 
 void resetBalls(World &world, int num = 1) {
-	lock_guard lock(world.mutex());
-	lock_guard lock2(world.get_system<world_system::circle>().mutex());
-	lock_guard lock3(world.get_system<world_system::color>().mutex());
-	lock_guard lock4(world.get_system<world_system::move>().mutex());
-	lock_guard lock5(world.get_system<world_system::color_transition>().mutex());
-	lock_guard lock6(world.get_system<world_system::life>().mutex());
-	lock_guard lock7(world.get_system<world_system::gravity>().mutex());
-
 	world.clear();
 
-	for (int i = 0; i < num; ++i) {
-		auto entity = world.make_entity();
-		entity.emplace_component<world_system::circle>(Circle(Vec2(Random(0, Window::Width()), Random(0, Window::Height())), Random(10, 50)));
-		entity.emplace_component<world_system::color>(RandomHSV());
-		entity.emplace_component<world_system::move>(RandomVec2(Random(10.0, 1000.0)));
-		entity.emplace_component<world_system::color_transition>(360.0);
-		entity.emplace_component<world_system::gravity>();
-		//entity.emplace_component<world_system::life>(Random(1.0, 10.0));
+	// 列ごとに値を用意してまとめて追加する
+	world.reserve(num);
+	const auto entities = world.create_many(num);
+
+	std::vector<Circle> circles;
+	std::vector<HSV> colors;
+	std::vector<Vec2> velocities;
+	circles.reserve(entities.size());
+	colors.reserve(entities.size());
+	velocities.reserve(entities.size());
+	for (size_t i = 0; i < entities.size(); ++i) {
+		circles.emplace_back(Vec2(Random(0, Window::Width()), Random(0, Window::Height())), Random(10, 50));
+		colors.emplace_back(RandomHSV());
+		velocities.emplace_back(RandomVec2(Random(10.0, 1000.0)));
 	}
+
+	world.emplace_range<world_system::circle>(entities, circles);
+	world.emplace_range<world_system::color>(entities, colors);
+	world.emplace_range<world_system::move>(entities, velocities);
+	world.emplace_range<world_system::color_transition>(entities, std::vector<double>(entities.size(), 360.0));
+	world.emplace_range<world_system::gravity>(entities);
 }
 
 void addEffects(World &world, int num = 1) {
-	lock_guard lock(world.mutex());
-	lock_guard lock2(world.get_system<world_system::circle>().mutex());
-	lock_guard lock3(world.get_system<world_system::move>().mutex());
-	lock_guard lock4(world.get_system<world_system::color_transition>().mutex());
-	lock_guard lock5(world.get_system<world_system::life>().mutex());
-	lock_guard lock6(world.get_system<world_system::color>().mutex());
-	for (int i = 0; i < num; ++i) {
-		auto entity = world.make_entity();
-		entity.emplace_component<world_system::circle>(Circle(Cursor::Pos(), Random(1, 10)));
-		entity.emplace_component<world_system::color>(RandomHSV());
-		entity.emplace_component<world_system::move>(RandomVec2(Random(100.0, 300.0)));
-		entity.emplace_component<world_system::color_transition>(360.0);
-		entity.emplace_component<world_system::life>(Random(0.1, 0.5));
+	const auto entities = world.create_many(num);
+
+	std::vector<Circle> circles;
+	std::vector<HSV> colors;
+	std::vector<Vec2> velocities;
+	std::vector<life_t> lives;
+	for (size_t i = 0; i < entities.size(); ++i) {
+		circles.emplace_back(Cursor::Pos(), Random(1, 10));
+		colors.emplace_back(RandomHSV());
+		velocities.emplace_back(RandomVec2(Random(100.0, 300.0)));
+		lives.emplace_back(Random(0.1, 0.5));
 	}
-}
 
-using thread_list = std::vector<std::thread>;
-
-template <class T>
-struct task {
-	using function_type = std::function<T>;
-
-	task(function_type f) : function(f) {}
-
-	std::condition_variable condition;
-	function_type function;
-};
+	world.emplace_range<world_system::circle>(entities, circles);
+	world.emplace_range<world_system::color>(entities, colors);
+	world.emplace_range<world_system::move>(entities, velocities);
+	world.emplace_range<world_system::color_transition>(entities, std::vector<double>(entities.size(), 360.0));
+	world.emplace_range<world_system::life>(entities, lives);
+}
 
 } // namespace
 
@@ -168,6 +150,7 @@ void Main()
 	World world;
 
 	resetBalls(world, num);
+	world.publish();
 
 	Graphics::SetBackground(ColorF(0.0, 0.0, 0.0));
 
@@ -175,303 +158,111 @@ void Main()
 
 	const Texture textureCat(Emoji(L"🐈"), TextureDesc::Mipped);
 
-	std::mutex main_mutex;
-	bool update = false;
-	std::condition_variable cond;
 	double delta = 0;
 
-	std::vector<std::future<bool>> futures;
-	{
-		std::vector<std::packaged_task<bool()>> tasks;
-
-		tasks.emplace_back(
-			[&]() {
-				while (true) {
-					{
-						std::unique_lock<std::mutex> main_lock(main_mutex);
-						cond.wait(main_lock, [&update] { return update; });
-					}
-
-					auto &system = world.get_system<world_system::life>();
-					auto &circle_sys = world.get_system<world_system::color>();
-
-					//lock_guard lock(system.mutex());
-
-					auto &entities = system.entities();
-
-					size_t size;
-					{
-						shared_lock slock(system.mutex());
-						size = entities.size();
-					}
-
-					auto &lifes = system.get_members<life_component::life>();
-					for (size_t i = 0; i < size; ++i) {
-						ecs::entity_id entity;
-						{
-							shared_lock slock(system.mutex());
-							entity = entities[i];
-						}
-						if (entity == ecs::invalid_entity_id) continue;
-
-						{
-							lock_guard lock(system.mutex());
-							lifes[i].current_life -= delta;
-						}
-						{
-							life_t life;
-							{
-								shared_lock slock(system.mutex());
-								life = lifes[i];
-							}
-							if (life.current_life < 0) {
-								lock_guard lockw(world.mutex());
-								world.remove_entity(entity);
-
-							} else if (circle_sys.mutex().try_lock()) {
-								if (circle_sys.validate_component(entity)) {
-									auto &color = circle_sys.get_member<color_component::color>(entity);
-									color.a = life.current_life / life.initial_life;
-								}
-								circle_sys.mutex().unlock();
-							}
-						}
-					}
-				}
-				return true;
-			}
-		);
-
-		tasks.emplace_back(
-			[&]() {
-				while (true) {
-					{
-						std::unique_lock<std::mutex> main_lock(main_mutex);
-						cond.wait(main_lock, [&update] { return update; });
+	// 各ジョブは読み書きするシステムを宣言し、競合しないジョブは並列に動く
+	ecs::scheduler<World> scheduler;
+
+	// 構造変更はフレーム完了後にまとめて反映する
+	ecs::command_queue<World> commands(world);
+
+	scheduler.add_job<ecs::reads<>, ecs::writes<world_system::life, world_system::color>>(
+		[&](World &world) {
+			auto &buffer = commands.local();
+			world.each<world_system::life, world_system::color>(
+				[&](ecs::entity_id entity, life_t &life, HSV &color) {
+					life.current_life -= delta;
+					if (life.current_life < 0) {
+						buffer.destroy(entity);
+					} else {
+						color.a = life.current_life / life.initial_life;
 					}
-
-					auto &system = world.get_system<world_system::color_transition>();
-					auto &circle_sys = world.get_system<world_system::color>();
-					if (!system.mutex().try_lock_shared()) continue;
-					//shared_lock slock(system.mutex());
-					//shared_lock slock2(circle_sys.mutex());
-
-					auto &entities = system.entities();
-
-					auto &trans = system.get_members<color_transition_component::hue>();
-					for (size_t i = 0; i < entities.size(); ++i) {
-						ecs::entity_id entity = entities[i];
-						if (entity == ecs::invalid_entity_id) continue;
-
-						{
-							shared_lock lockc(circle_sys.mutex());
-							if (!circle_sys.validate_component(entities[i])) continue;
-						}
-						if (circle_sys.mutex().try_lock()) {
-							//lock_guard lockc(circle_sys.mutex());
-							auto &color = circle_sys.get_member<color_component::color>(entities[i]);
-							color.h += trans[i] * delta;
-							if (color.h <   0) color.h += 360;
-							if (color.h > 360) color.h -= 360;
-							circle_sys.mutex().unlock();
-						}
-					}
-
-					system.mutex().unlock_shared();
 				}
-				return true;
-			}
-		);
-
-		tasks.emplace_back(
-			[&]() {
-				while (true) {
-					{
-						std::unique_lock<std::mutex> main_lock(main_mutex);
-						cond.wait(main_lock, [&update] { return update; });
-					}
-
-					auto &system = world.get_system<world_system::gravity>();
-					auto &move_sys = world.get_system<world_system::move>();
-					shared_lock slock(system.mutex());
-					//lock_guard lock2(move_sys.mutex());
-					if (!move_sys.mutex().try_lock()) continue;
-
-					auto &entities = system.entities();
-
-					for (size_t i = 0; i < entities.size(); ++i) {
-						if (entities[i] == ecs::invalid_entity_id) continue;
-
-						{
-							if (!move_sys.validate_component(entities[i])) continue;
-						}
-
-						{
-							auto &velocity = move_sys.get_member<move_component::velocity>(entities[i]);
-							velocity.y += 9.80665 * delta * 100;
-						}
-					}
-					move_sys.mutex().unlock();
+			);
+		}
+	);
+
+	scheduler.add_job<ecs::reads<world_system::color_transition>, ecs::writes<world_system::color>>(
+		[&](World &world) {
+			world.each<world_system::color_transition, world_system::color>(
+				[&](ecs::entity_id, double hue, HSV &color) {
+					color.h += hue * delta;
+					if (color.h <   0) color.h += 360;
+					if (color.h > 360) color.h -= 360;
 				}
-				return true;
-			}
-		);
-
-		tasks.emplace_back(
-			[&]() {
-				while (true) {
-					{
-						std::unique_lock<std::mutex> main_lock(main_mutex);
-						cond.wait(main_lock, [&update] { return update; });
-					}
-
-					auto &system = world.get_system<world_system::move>();
-					auto &circle_sys = world.get_system<world_system::circle>();
-
-					//lock_guard lock(system.mutex());
-
-					auto &entities = system.entities();
-					auto &velocities = system.get_members<move_component::velocity>();
-
-					size_t size;
-					{
-						shared_lock slock(system.mutex());
-						size = entities.size();
-					}
+			);
+		}
+	);
 
-					for (size_t i = 0; i < size; ++i) {
-						ecs::entity_id entity;
-						{
-							shared_lock slock(system.mutex());
-							entity = entities[i];
-						}
-						if (entity == ecs::invalid_entity_id) continue;
-
-						{
-							shared_lock slock(circle_sys.mutex());
-							if (!circle_sys.validate_component(entity)) continue;
-						}
-						{
-							lock_guard locks(system.mutex());
-							lock_guard lockc(circle_sys.mutex());
-							{
-								auto &center = circle_sys.get_member<circle_component::circle>(entity).center;
-								auto &velocity = velocities[i];
-								center += velocity * delta;
-								constexpr auto cor = 0.9;
-								auto rect = Window::ClientRect();
-								if (center.x < 0) {
-									center.x = 0;
-									velocity.x = -velocity.x * cor;
-
-								} else if (center.x > rect.w) {
-									center.x = rect.w;
-									velocity.x = -velocity.x * cor;
-								}
-								if (center.y < 0) {
-									center.y = 0;
-									velocity.y = -velocity.y * cor;
-
-								} else if (center.y > rect.h) {
-									center.y = rect.h;
-									velocity.y = -velocity.y * cor;
-								}
-							}
-						}
-					}
+	scheduler.add_job<ecs::reads<world_system::gravity>, ecs::writes<world_system::move>>(
+		[&](World &world) {
+			world.each<world_system::gravity, world_system::move>(
+				[&](ecs::entity_id, Vec2 &velocity) {
+					velocity.y += 9.80665 * delta * 100;
 				}
-				return true;
-			}
-		);
-#if 0
-		tasks.emplace_back(
-			[&]() {
-				while (true) {
-					{
-						std::unique_lock<std::mutex> main_lock(main_mutex);
-						cond.wait(main_lock, [&update] { return update; });
+			);
+		}
+	);
+
+	scheduler.add_job<ecs::reads<>, ecs::writes<world_system::move, world_system::circle>>(
+		[&](World &world) {
+			const auto rect = Window::ClientRect();
+
+			world.each<world_system::move, world_system::circle>(
+				[&](ecs::entity_id, Vec2 &velocity, Circle &circle) {
+					auto &center = circle.center;
+					center += velocity * delta;
+					constexpr auto cor = 0.9;
+					if (center.x < 0) {
+						center.x = 0;
+						velocity.x = -velocity.x * cor;
+
+					} else if (center.x > rect.w) {
+						center.x = rect.w;
+						velocity.x = -velocity.x * cor;
 					}
+					if (center.y < 0) {
+						center.y = 0;
+						velocity.y = -velocity.y * cor;
 
-					auto &system = world.get_system<world_system::circle>();
-					auto &color_sys = world.get_system<world_system::color>();
-					shared_lock lock(system.mutex());
-					const auto &entities = system.entities();
-					const auto &circles = system.get_members<circle_component::circle>();
-					for (size_t i = 0; i < circles.size(); ++i) {
-						if (entities[i] == ecs::invalid_entity_id) continue;
-
-						HSV color;
-						{
-							shared_lock lockc(color_sys.mutex());
-							color = color_sys.get_member<color_component::color>(entities[i]);
-						}
-						//circles[i].draw(color);
+					} else if (center.y > rect.h) {
+						center.y = rect.h;
+						velocity.y = -velocity.y * cor;
 					}
 				}
-				return true;
-			}
-		);
-#endif
-		//std::this_thread::yield();
-
-		std::for_each(
-			tasks.begin(),
-			tasks.end(),
-			[&futures](auto &task) {
-				futures.emplace_back(task.get_future());
-				std::thread t(std::move(task));
-				t.detach();
-			}
-		);
-	}
+			);
+		}
+	);
 
-	while (true)
+	while (System::Update())
 	{
-		{
-			std::lock_guard<std::mutex> main_lock(main_mutex);
-			if (!System::Update()) break;
-			update = true;
-			delta = System::DeltaTime();
-		}
+		delta = System::DeltaTime();
 
 		Window::SetTitle(Profiler::FPS(), L" FPS : entities=", world.entity_size());
 
-		cond.notify_all();
-		{
-			std::lock_guard<std::mutex> main_lock(main_mutex);
+		// ジョブが裏を書き換えている間に、前フレームの表を描画する
+		auto frame = scheduler.run(world);
 
-			auto rect = Window::ClientRect();
-			if (rect.leftClicked()) {
-				addEffects(world, 10);
-			}
-			if (KeySpace.down()) {
-				resetBalls(world, num);
+		world.each_front<world_system::circle, world_system::color>(
+			[](ecs::entity_id, const Circle &circle, const HSV &color) {
+				circle.draw(color);
 			}
+		);
+
+		// フレーム完了を待つ
+		scheduler.wait(frame);
+		commands.flush();
+
+		auto rect = Window::ClientRect();
+		if (rect.leftClicked()) {
+			addEffects(world, 10);
 		}
-		{
-			std::lock_guard<std::mutex> main_lock(main_mutex);
-
-			auto &system = world.get_system<world_system::circle>();
-			auto &color_sys = world.get_system<world_system::color>();
-			shared_lock lock(system.mutex());
-			const auto &entities = system.entities();
-			const auto &circles = system.get_members<circle_component::circle>();
-			for (size_t i = 0; i < circles.size(); ++i) {
-				if (entities[i] == ecs::invalid_entity_id) continue;
-
-				HSV color;
-				{
-					shared_lock lockc(color_sys.mutex());
-					color = color_sys.get_member<color_component::color>(entities[i]);
-				}
-				circles[i].draw(color);
-			}
+		if (KeySpace.down()) {
+			resetBalls(world, num);
 		}
 
-		{
-			std::lock_guard<std::mutex> main_lock(main_mutex);
-			update = false;
-		}
+		// 構造変更を反映してから表と裏を入れ替える
+		world.publish();
 #if 0
 		font(L"Hello, Siv3D!🐣").drawAt(Window::Center(), Palette::Black);
 		font(Cursor::Pos()).draw(20, 400, ColorF(0.6));
@@ -1,7 +1,10 @@
 #include <iostream>
 #include <string>
+#include <sstream>
+#include <cstring>
 
 #include "entity_component_system/entity_component_system.hpp"
+#include "entity_component_system/snapshot.hpp"
 
 namespace ecs = entity_component_system;
 
@@ -87,6 +90,30 @@ void test_remove_component() {
 	std::cout << std::endl;
 }
 
+void test_packed_system() {
+	std::cout << "test_packed_system ----------" << std::endl;
+
+	ecs::packed_system<int> system;
+
+	system.emplace_component(0, 123);
+	system.emplace_component(1, 456);
+	system.emplace_component(2, 789);
+
+	for (auto &member : system.get_members<0>()) {
+		std::cout << member << std::endl;
+	}
+
+	system.remove_component(0);
+	system.emplace_component(3, 999);
+
+	std::cout << "----------" << std::endl;
+	for (size_t i = 0; i < system.entity_size(); ++i) {
+		std::cout << system.get_members<0>()[i] << ": " << system.get_members<1>()[i] << std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
 void test_system_size() {
 	std::cout << "test_system_size ----------" << std::endl;
 
@@ -181,13 +208,380 @@ void test_world() {
 	}
 }
 
+void test_entity_generation() {
+	std::cout << "test_entity_generation ----------" << std::endl;
+
+	using my_world = ecs::world<ecs::system<int>>;
+
+	my_world world;
+
+	auto stale = world.make_entity();
+	stale.emplace_component(123);
+	ecs::entity_id stale_id = stale;
+	stale.destroy();
+
+	auto entity = world.make_entity();
+	entity.emplace_component(456);
+
+	std::cout << "stale: index = " << ecs::entity_index(stale_id) << ", generation = " << ecs::entity_generation(stale_id) << std::endl;
+	std::cout << "fresh: index = " << ecs::entity_index(entity) << ", generation = " << ecs::entity_generation(entity) << std::endl;
+	std::cout << "stale alive: " << world.is_alive(stale_id) << ", has_component: " << world.get_system().has_component(stale_id) << std::endl;
+	std::cout << "fresh alive: " << world.is_alive(entity) << ", has_component: " << world.get_system().has_component(entity) << std::endl;
+
+	std::cout << std::endl;
+}
+
+// a component added through the system itself goes with its entity
+void test_remove_entity() {
+	std::cout << "test_remove_entity ----------" << std::endl;
+
+	using my_world = ecs::world<ecs::system<int>>;
+
+	my_world world;
+
+	const auto e = world.make_entity().id();
+	world.get_system<0>().emplace_component(e, 1);
+	world.remove_entity(e);
+
+	const auto f = world.make_entity().id();
+	world.emplace_component<0>(f, 2);
+
+	std::cout << "reused index: " << (ecs::entity_index(e) == ecs::entity_index(f)) << ", has_component: " << world.has_component<0>(f) << std::endl;
+	world.each<0>([](ecs::entity_id id, int value) {
+		std::cout << ecs::entity_generation(id) << ": " << value << std::endl;
+	});
+
+	std::cout << std::endl;
+}
+
+// an older generation still holds the index when a newer one is added
+template <class System>
+void check_stale_component(const char *name) {
+	System system;
+
+	const auto stale = ecs::make_entity_id(5, 0);
+	const auto fresh = ecs::make_entity_id(5, 1);
+
+	system.emplace_component(ecs::make_entity_id(4, 0), 4);
+	system.emplace_component(stale, 5);
+	system.emplace_component(fresh, 6);
+
+	std::cout
+		<< name << ": stale has_component: " << system.has_component(stale)
+		<< ", fresh: " << system.template get_member<1>(fresh)
+		<< ", live_size: " << system.live_size()
+		<< std::endl;
+}
+
+void test_stale_component() {
+	std::cout << "test_stale_component ----------" << std::endl;
+
+	check_stale_component<ecs::system<int>>("sparse");
+	check_stale_component<ecs::packed_system<int>>("packed");
+	check_stale_component<ecs::hashed_system<int>>("hashed");
+
+	std::cout << std::endl;
+}
+
+void test_view() {
+	std::cout << "test_view ----------" << std::endl;
+
+	using position_system = ecs::system<int, int>;
+	using velocity_system = ecs::packed_system<int, int>;
+	using tag_system = ecs::system<>;
+
+	using my_world = ecs::world<position_system, velocity_system, tag_system>;
+
+	my_world world;
+	for (int i = 0; i < 10; ++i) {
+		auto entity = world.make_entity();
+		entity.emplace_component<0>(int(i), i * 10);
+		if (i % 2 == 0) entity.emplace_component<1>(1, -1);
+		if (i % 3 == 0) entity.emplace_component<2>();
+	}
+
+	world.each<0, 1>([](ecs::entity_id, int &x, int &y, int vx, int vy) {
+		x += vx;
+		y += vy;
+	});
+
+	world.each<2, 0>([](ecs::entity_id id, const int &x, const int &y) {
+		std::cout << ecs::entity_index(id) << ": " << x << ", " << y << std::endl;
+	});
+
+	std::cout << std::endl;
+}
+
+void test_change_tracking() {
+	std::cout << "test_change_tracking ----------" << std::endl;
+
+	using color_system = ecs::tracked_system<int>;
+
+	using my_world = ecs::world<color_system>;
+
+	my_world world;
+	std::vector<ecs::entity_id> ids;
+	for (int i = 0; i < 10; ++i) {
+		auto entity = world.make_entity();
+		entity.emplace_component<0>(int(i));
+		ids.push_back(entity.id());
+	}
+
+	const auto since = world.tick();
+	world.advance_tick();
+
+	world.get_system<0>().get_member<1>(ids[3]) = 30;
+	world.get_system<0>().get_member<1>(ids[7]) = 70;
+	world.get_system<0>().get_member<1>(ids[3]) = 31;
+
+	world.changed<0, 1>(since).each([](ecs::entity_id id, const int &color) {
+		std::cout << ecs::entity_index(id) << ": " << color << std::endl;
+	});
+
+	std::cout << std::endl;
+}
+
+void test_snapshot() {
+	std::cout << "test_snapshot ----------" << std::endl;
+
+	using name_system = ecs::system<std::string>;
+	using position_system = ecs::system<int, int>;
+
+	using my_world = ecs::world<name_system, position_system>;
+
+	my_world world;
+	{
+		auto entity = world.make_entity();
+		entity.emplace_component<0>(std::string("alpha"));
+		entity.emplace_component<1>(1, 2);
+	}
+	{
+		auto entity = world.make_entity();
+		entity.emplace_component<0>(std::string("bravo"));
+	}
+
+	std::ostringstream stream(std::ios::binary);
+	ecs::save_snapshot(world, stream);
+	const auto bytes = stream.str();
+
+	my_world restored;
+	ecs::load_snapshot(restored, bytes.data(), bytes.size());
+
+	std::cout << bytes.size() << " bytes" << std::endl;
+	for (auto id : restored.entities()) {
+		std::cout << id << ": " << std::get<1>(restored.get_component<0>(id));
+		if (restored.has_component<1>(id)) {
+			const auto position = restored.get_component<1>(id);
+			std::cout << " (" << std::get<1>(position) << ", " << std::get<2>(position) << ")";
+		}
+		std::cout << std::endl;
+	}
+
+	// the first live id, after the header (24 bytes), the generations
+	// (64 + 8) and the index pool (16), then the live list's own header
+	auto corrupt = bytes;
+	const ecs::entity_id bad_id = 0x00FFFFF0;
+	std::memcpy(&corrupt[128], &bad_id, sizeof(bad_id));
+	try {
+		ecs::load_snapshot(restored, corrupt.data(), corrupt.size());
+
+	} catch (const std::runtime_error &e) {
+		std::cout << e.what() << ", " << restored.entity_size() << " entities" << std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
+void test_statistics() {
+	std::cout << "test_statistics ----------" << std::endl;
+
+	using position_system = ecs::system<int, int>;
+	using color_system = ecs::packed_system<int>;
+
+	using my_world = ecs::world<position_system, color_system>;
+
+	my_world world;
+	std::vector<ecs::entity_id> ids;
+	for (int i = 0; i < 10; ++i) {
+		auto entity = world.make_entity();
+		entity.emplace_component<0>(int(i), int(i));
+		entity.emplace_component<1>(int(i));
+		ids.push_back(entity.id());
+	}
+	for (size_t i = 0; i < ids.size(); i += 3) {
+		world.remove_entity(ids[i]);
+	}
+
+	world.invoke_system<0>([](my_world &, position_system &system) {
+		std::cout << "invoke: " << system.live_size() << " components" << std::endl;
+	});
+
+	const auto statistics = world.statistics();
+	std::cout << "entities: " << statistics.entities << ", free ids: " << statistics.free_ids << std::endl;
+	for (const auto &system : statistics.systems) {
+		std::cout << system.live << " / " << system.slots << " slots, " << system.bytes << " bytes, " << system.invokes.count << " invokes" << std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
+void test_spatial_grid() {
+	std::cout << "test_spatial_grid ----------" << std::endl;
+
+	using position_system = ecs::system<float, float>;
+
+	using my_world = ecs::world<position_system>;
+
+	my_world world;
+	for (int i = 0; i < 10; ++i) {
+		auto entity = world.make_entity();
+		entity.emplace_component<0>(i * 10.0f, 0.0f);
+	}
+
+	ecs::spatial_grid<float> grid(16.0f);
+	grid.update_from<1, 2>(world.get_system<0>(), 4.0f, 4.0f);
+
+	grid.query_radius(30.0f, 0.0f, 12.0f, [](ecs::entity_id id, const ecs::aabb<float> &bounds) {
+		std::cout << ecs::entity_index(id) << ": " << bounds.min_x << " - " << bounds.max_x << std::endl;
+	});
+
+	world.get_system<0>().get_member<1>(world.entities()[9]) = 32.0f;
+	grid.update_from<1, 2>(world.get_system<0>(), 4.0f, 4.0f);
+
+	grid.each_overlapping_pair([](ecs::entity_id a, ecs::entity_id b) {
+		std::cout << "overlap: " << ecs::entity_index(a) << ", " << ecs::entity_index(b) << std::endl;
+	});
+
+	std::cout << std::endl;
+}
+
+// entities die and their indices are reused within the same frame
+void test_spatial_grid_churn() {
+	std::cout << "test_spatial_grid_churn ----------" << std::endl;
+
+	using position_system = ecs::system<float, float>;
+
+	using my_world = ecs::world<position_system>;
+
+	my_world world;
+	for (int i = 0; i < 64; ++i) {
+		world.make_entity().emplace_component<0>(i * 4.0f, 0.0f);
+	}
+
+	ecs::spatial_grid<float> grid(16.0f);
+	bool ok = true;
+	for (int frame = 0; frame < 32; ++frame) {
+		grid.update_from<1, 2>(world.get_system<0>(), 2.0f, 2.0f);
+
+		const auto &system = world.get_system<0>();
+		ok = ok && (grid.size() == system.live_size());
+		for (auto id : system.entities()) {
+			if (id == ecs::invalid_entity_id) continue;
+
+			const auto &bounds = grid.bounds(id);
+			ok = ok && (bounds.min_x + 2.0f == system.get_member<1>(id));
+		}
+
+		// kill every third entity and spawn as many, on the freed indices
+		const auto entities = world.entities();
+		for (std::size_t i = frame % 3; i < entities.size(); i += 3) {
+			world.remove_entity(entities[i]);
+			world.make_entity().emplace_component<0>(frame * 8.0f + i, 16.0f);
+		}
+	}
+
+	std::cout << grid.size() << " boxes, " << world.get_system<0>().live_size() << " entities " << (ok ? "OK!" : "NG") << std::endl;
+
+	std::cout << std::endl;
+}
+
+struct countdown {
+	int count;
+
+	bool update(ecs::entity_id id, int step) {
+		count -= step;
+		std::cout << ecs::entity_index(id) << ": " << count << std::endl;
+		return count > 0;
+	}
+};
+
+void test_behaviours() {
+	std::cout << "test_behaviours ----------" << std::endl;
+
+	using countdown_system = ecs::packed_system<countdown>;
+
+	using my_world = ecs::world<countdown_system>;
+
+	my_world world;
+	for (int i = 1; i <= 3; ++i) {
+		world.make_entity().emplace_component<0>(countdown { i * 2 });
+	}
+
+	while (world.update_behaviours<0>(2) > 0) {
+		std::cout << world.entity_size() << " left" << std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
+void test_compact() {
+	std::cout << "test_compact ----------" << std::endl;
+
+	using my_system = ecs::system<int>;
+
+	my_system system;
+	for (ecs::entity_id id = 0; id < 8; ++id) {
+		system.add_component(7 - id, my_system::make_component(7 - id, int(id)));
+	}
+	system.remove_component(2);
+	system.remove_component(5);
+
+	auto dump = [&] {
+		for (auto id : system.entities()) {
+			if (id == ecs::invalid_entity_id) {
+				std::cout << "- ";
+
+			} else {
+				std::cout << id << " ";
+			}
+		}
+		std::cout << std::endl;
+	};
+	dump();
+
+	system.compact();
+	dump();
+
+	system.compact_by(ecs::by_entity_index());
+	dump();
+
+	// by value
+	system.reset_compaction();
+	system.compact_by([](ecs::entity_id, int value) { return value; });
+	dump();
+
+	std::cout << std::endl;
+}
+
 int main() {
 	//test_system();
 	//test_empty_system();
 	//test_component();
 	//test_remove_component();
+	//test_packed_system();
 	//test_system_size();
 	test_world();
+	//test_entity_generation();
+	//test_remove_entity();
+	//test_stale_component();
+	//test_view();
+	//test_change_tracking();
+	//test_snapshot();
+	//test_statistics();
+	//test_spatial_grid();
+	//test_spatial_grid_churn();
+	//test_behaviours();
+	//test_compact();
 
 #if _DEBUG
 	system("pause");
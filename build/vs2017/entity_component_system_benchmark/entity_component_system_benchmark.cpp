@@ -0,0 +1,791 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <cmath>
+
+#include "entity_component_system/entity_component_system.hpp"
+
+namespace ecs = entity_component_system;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+template <class F>
+double measure(size_t count, F fn) {
+	auto begin = clock_type::now();
+	fn();
+	auto end = clock_type::now();
+	return std::chrono::duration<double, std::nano>(end - begin).count() / static_cast<double>(count);
+}
+
+enum class output_format {
+	table,
+	csv,
+	json,
+};
+
+struct options {
+	output_format format = output_format::table;
+	size_t min_size = 1000;
+	size_t max_size = 10000000;
+	std::string filter;
+};
+
+options &settings() {
+	static options instance;
+	return instance;
+}
+
+bool enabled(const std::string &bench) {
+	return settings().filter.empty() || (bench.find(settings().filter) != std::string::npos);
+}
+
+// 1k, 10k, ... within [min_size, max_size]
+std::vector<size_t> sizes() {
+	std::vector<size_t> result;
+	for (size_t size = 1000; size <= 10000000; size *= 10) {
+		if ((size >= settings().min_size) && (size <= settings().max_size)) {
+			result.push_back(size);
+		}
+	}
+	return result;
+}
+
+// one line per measurement; csv and json (one object per line) are for scripts
+void report(const std::string &name, size_t size, const std::string &operation, double ns_per_op, double bytes_per_entity = 0) {
+	const double ops_per_sec = (ns_per_op > 0) ? (1e9 / ns_per_op) : 0;
+
+	switch (settings().format) {
+	case output_format::table:
+		std::cout
+			<< std::left << std::setw(24) << name
+			<< std::right << std::setw(10) << size << "  "
+			<< std::left << std::setw(20) << operation
+			<< std::right << std::setw(10) << std::fixed << std::setprecision(2) << ns_per_op << " ns/op"
+			<< std::setw(14) << std::setprecision(0) << ops_per_sec << " op/s";
+		if (bytes_per_entity > 0) {
+			std::cout << std::setw(10) << std::setprecision(1) << bytes_per_entity << " B/entity";
+		}
+		std::cout << std::endl;
+		break;
+
+	case output_format::csv:
+		std::cout
+			<< name << ',' << size << ',' << operation << ','
+			<< std::fixed << std::setprecision(3) << ns_per_op << ','
+			<< std::setprecision(0) << ops_per_sec << ','
+			<< std::setprecision(1) << bytes_per_entity << std::endl;
+		break;
+
+	case output_format::json:
+		std::cout
+			<< "{\"name\":\"" << name << "\",\"size\":" << size << ",\"operation\":\"" << operation << "\""
+			<< ",\"ns_per_op\":" << std::fixed << std::setprecision(3) << ns_per_op
+			<< ",\"ops_per_sec\":" << std::setprecision(0) << ops_per_sec
+			<< ",\"bytes_per_entity\":" << std::setprecision(1) << bytes_per_entity << "}" << std::endl;
+		break;
+	}
+}
+
+void section(const std::string &name) {
+	if (settings().format == output_format::table) {
+		std::cout << name << " ----------" << std::endl;
+	}
+}
+
+void end_section() {
+	if (settings().format == output_format::table) {
+		std::cout << std::endl;
+	}
+}
+
+std::vector<ecs::entity_id> make_ids(size_t size, unsigned int seed) {
+	std::vector<ecs::entity_id> ids(size);
+	std::iota(ids.begin(), ids.end(), 0);
+	std::shuffle(ids.begin(), ids.end(), std::mt19937(seed));
+	return ids;
+}
+
+template <class System>
+void bench_lookup(const std::string &name, size_t size) {
+	auto ids = make_ids(size, 1);
+	auto probes = make_ids(size, 2);
+
+	System system;
+
+	report(name, size, "emplace_component", measure(size, [&] {
+		for (auto id : ids) {
+			system.emplace_component(id, static_cast<float>(id));
+		}
+	}));
+
+	float sum = 0;
+	report(name, size, "get_member", measure(size, [&] {
+		for (auto id : probes) {
+			sum += system.template get_member<1>(id);
+		}
+	}));
+
+	size_t found = 0;
+	report(name, size, "has_component", measure(size, [&] {
+		for (auto id : probes) {
+			found += system.has_component(id) ? 1 : 0;
+		}
+	}));
+
+	report(name, size, "validate_component", measure(size, [&] {
+		for (auto id : probes) {
+			found += system.validate_component(id) ? 1 : 0;
+		}
+	}));
+
+	report(name, size, "remove_component", measure(size, [&] {
+		for (auto id : probes) {
+			system.remove_component(id);
+		}
+	}));
+
+	// keep the results observable
+	if (sum < 0 || found == 0) {
+		std::cout << sum << found << std::endl;
+	}
+}
+
+void bench_entity_map() {
+	section("bench_entity_map");
+
+	for (auto size : sizes()) {
+		bench_lookup<ecs::hashed_system<float>>("hashed_system<float>", size);
+		bench_lookup<ecs::sparse_system<float>>("sparse_system<float>", size);
+		bench_lookup<ecs::paged_system<float>>("paged_system<float>", size);
+	}
+
+	end_section();
+}
+
+using particle_system = ecs::packed_system<float, float, float, float>;
+
+struct particle_component {
+	enum index : size_t {
+		entity,
+		x,
+		y,
+		vx,
+		vy,
+	};
+};
+
+using particle_world = ecs::world<particle_system>;
+
+template <class System>
+void integrate(System &system, size_t begin, size_t end) {
+	auto &xs = system.template get_members<particle_component::x>();
+	auto &ys = system.template get_members<particle_component::y>();
+	auto &vxs = system.template get_members<particle_component::vx>();
+	auto &vys = system.template get_members<particle_component::vy>();
+	constexpr float dt = 1.0f / 60.0f;
+	for (size_t i = begin; i < end; ++i) {
+		const float length = std::sqrt(vxs[i] * vxs[i] + vys[i] * vys[i]) + 1.0f;
+		vxs[i] -= vxs[i] / length * dt;
+		vys[i] += 9.80665f * dt;
+		xs[i] += vxs[i] * dt;
+		ys[i] += vys[i] * dt;
+	}
+}
+
+void bench_parallel_invoke() {
+	section("bench_parallel_invoke");
+
+	const size_t size = std::min<size_t>(1000000, settings().max_size);
+	constexpr size_t repeat = 20;
+
+	particle_world world;
+	for (size_t i = 0; i < size; ++i) {
+		auto entity = world.make_entity();
+		entity.emplace_component(static_cast<float>(i % 640), static_cast<float>(i % 480), 1.0f, -1.0f);
+	}
+
+	const auto single = measure(size * repeat, [&] {
+		for (size_t r = 0; r < repeat; ++r) {
+			world.invoke_system([](auto &, auto &system) {
+				integrate(system, 0, system.entity_size());
+			});
+		}
+	});
+	report("invoke_system", size, "threads=1", single);
+
+	const size_t concurrency = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	for (size_t threads = 1; threads <= concurrency; threads *= 2) {
+		// the calling thread works too; a single thread runs one chunk inline
+		utility::thread_pool pool(std::max<size_t>(threads - 1, 1));
+		const size_t grain = (threads == 1) ? size : 0;
+
+		const auto parallel = measure(size * repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				world.parallel_invoke_system(
+					[](auto &, auto &system, size_t begin, size_t end) {
+						integrate(system, begin, end);
+					},
+					grain,
+					pool
+				);
+			}
+		});
+		report("parallel_invoke_system", size, "threads=" + std::to_string(threads), parallel);
+		if (settings().format == output_format::table) {
+			std::cout << std::setw(58) << "speedup x" << std::setprecision(2) << (single / parallel) << std::endl;
+		}
+	}
+
+	end_section();
+}
+
+using position_system = ecs::system<float, float>;
+using velocity_system = ecs::system<float, float>;
+using color_system = ecs::system<unsigned int>;
+using frozen_system = ecs::system<>;
+
+enum layout_system : size_t {
+	position,
+	velocity,
+	color,
+	frozen,
+};
+
+using per_system_world = ecs::world<position_system, velocity_system, color_system, frozen_system>;
+using archetype_layout_world = ecs::archetype_world<position_system, velocity_system, color_system, frozen_system>;
+
+template <class World>
+void bench_world_layout(const std::string &name, size_t size) {
+	constexpr size_t repeat = 20;
+
+	World world;
+	std::vector<ecs::entity_id> ids;
+	ids.reserve(size);
+
+	report(name, size, "create", measure(size, [&] {
+		for (size_t i = 0; i < size; ++i) {
+			auto entity = world.make_entity();
+			entity.template emplace_component<layout_system::position>(static_cast<float>(i % 640), static_cast<float>(i % 480));
+			entity.template emplace_component<layout_system::velocity>(1.0f, -1.0f);
+			if (i % 2) entity.template emplace_component<layout_system::color>(static_cast<unsigned int>(i));
+			if (i % 3 == 0) entity.template emplace_component<layout_system::frozen>();
+			ids.push_back(entity.id());
+		}
+	}));
+
+	report(name, size, "each<position,velocity>", measure(size * repeat, [&] {
+		for (size_t r = 0; r < repeat; ++r) {
+			world.template each<layout_system::position, layout_system::velocity>(
+				[](ecs::entity_id, float &x, float &y, float &vx, float &vy) {
+					x += vx;
+					y += vy;
+				}
+			);
+		}
+	}));
+
+	std::shuffle(ids.begin(), ids.end(), std::mt19937(3));
+	float sum = 0;
+	report(name, size, "get_component", measure(size, [&] {
+		for (auto id : ids) {
+			sum += std::get<1>(world.template get_component<layout_system::position>(id));
+		}
+	}));
+
+	report(name, size, "remove_component", measure(size, [&] {
+		for (auto id : ids) {
+			world.template remove_component<layout_system::velocity>(id);
+		}
+	}));
+
+	if (sum < 0) {
+		std::cout << sum << std::endl;
+	}
+}
+
+void bench_world_layouts() {
+	section("bench_world_layouts");
+
+	for (auto size : sizes()) {
+		bench_world_layout<per_system_world>("world", size);
+		bench_world_layout<archetype_layout_world>("archetype_world", size);
+	}
+
+	end_section();
+}
+
+// the same three systems on every storage
+template <class Storage>
+using suite_world = ecs::world<
+	ecs::basic_system<Storage, float, float>,
+	ecs::basic_system<Storage, float, float>,
+	ecs::basic_system<Storage, int>
+>;
+
+using suite_archetype_world = ecs::archetype_world<
+	ecs::system<float, float>,
+	ecs::system<float, float>,
+	ecs::system<int>
+>;
+
+enum suite_system : size_t {
+	suite_position,
+	suite_velocity,
+	suite_health,
+};
+
+// every entity has a position and a velocity, every other one a health
+template <class World>
+ecs::entity_id spawn(World &world, size_t i) {
+	auto entity = world.make_entity();
+	entity.template emplace_component<suite_position>(static_cast<float>(i % 640), static_cast<float>(i % 480));
+	entity.template emplace_component<suite_velocity>(1.0f, -1.0f);
+	if (i % 2) entity.template emplace_component<suite_health>(static_cast<int>(i));
+	return entity.id();
+}
+
+// enough passes over small worlds to measure about a million operations
+size_t repeat_for(size_t size) {
+	return std::max<size_t>(1000000 / size, 1);
+}
+
+template <class World>
+void bench_storage(const std::string &name, size_t size) {
+	std::mt19937 engine(static_cast<unsigned int>(size));
+
+	World world;
+	std::vector<ecs::entity_id> ids;
+	ids.reserve(size);
+
+	const auto create = measure(size, [&] {
+		for (size_t i = 0; i < size; ++i) {
+			ids.push_back(spawn(world, i));
+		}
+	});
+	report(name, size, "create", create, static_cast<double>(world.memory_usage()) / world.entity_size());
+
+	const auto repeat = repeat_for(size);
+	float sum = 0;
+	report(name, size, "each<position>", measure(size * repeat, [&] {
+		for (size_t r = 0; r < repeat; ++r) {
+			world.template each<suite_position>([&](ecs::entity_id, const float &x, const float &) {
+				sum += x;
+			});
+		}
+	}));
+
+	report(name, size, "each<pos,vel,health>", measure(size * repeat, [&] {
+		for (size_t r = 0; r < repeat; ++r) {
+			world.template each<suite_position, suite_velocity, suite_health>(
+				[&](ecs::entity_id, float &x, float &y, const float &vx, const float &vy, const int &) {
+					x += vx;
+					y += vy;
+				}
+			);
+		}
+	}));
+
+	auto probes = ids;
+	std::shuffle(probes.begin(), probes.end(), engine);
+	report(name, size, "get_component", measure(size, [&] {
+		for (auto id : probes) {
+			sum += std::get<2>(world.template get_component<suite_position>(id));
+		}
+	}));
+
+	// destroy and recreate a tenth of the entities per round
+	constexpr size_t rounds = 10;
+	const size_t batch = std::max<size_t>(size / 10, 1);
+	const auto churn = measure(rounds * batch * 2, [&] {
+		for (size_t r = 0; r < rounds; ++r) {
+			for (size_t k = 0; k < batch; ++k) {
+				auto &id = ids[engine() % ids.size()];
+				world.remove_entity(id);
+				id = spawn(world, k);
+			}
+		}
+	});
+	report(name, size, "churn", churn, static_cast<double>(world.memory_usage()) / world.entity_size());
+
+	// half of the entities gone in random order leaves holes everywhere
+	std::shuffle(ids.begin(), ids.end(), engine);
+	const auto half = ids.size() / 2;
+	for (size_t i = half; i < ids.size(); ++i) {
+		world.remove_entity(ids[i]);
+	}
+	ids.resize(half);
+
+	report(name, size, "each_fragmented", measure(std::max<size_t>(half, 1) * repeat, [&] {
+		for (size_t r = 0; r < repeat; ++r) {
+			world.template each<suite_position>([&](ecs::entity_id, const float &x, const float &) {
+				sum += x;
+			});
+		}
+	}), static_cast<double>(world.memory_usage()) / std::max<size_t>(world.entity_size(), 1));
+
+	report(name, size, "remove_fragmented", measure(std::max<size_t>(half, 1), [&] {
+		for (auto id : ids) {
+			world.remove_entity(id);
+		}
+	}));
+
+	if (sum < 0) {
+		std::cout << sum << std::endl;
+	}
+}
+
+void bench_storages() {
+	section("bench_storages");
+
+	for (auto size : sizes()) {
+		bench_storage<suite_world<ecs::sparse_storage>>("world<sparse>", size);
+		bench_storage<suite_world<ecs::packed_storage>>("world<packed>", size);
+		bench_storage<suite_world<ecs::paged_storage>>("world<paged>", size);
+		bench_storage<suite_world<ecs::hashed_storage>>("world<hashed>", size);
+		bench_storage<suite_archetype_world>("archetype_world", size);
+	}
+
+	end_section();
+}
+
+// size entities, each replaced once in random order, then a quarter dropped
+template <class World>
+std::vector<ecs::entity_id> spawn_scattered(World &world, size_t size) {
+	std::mt19937 engine(static_cast<unsigned int>(size));
+
+	std::vector<ecs::entity_id> ids;
+	ids.reserve(size);
+	for (size_t i = 0; i < size; ++i) {
+		ids.push_back(spawn(world, i));
+	}
+
+	std::shuffle(ids.begin(), ids.end(), engine);
+	for (size_t i = 0; i < ids.size(); ++i) {
+		world.remove_entity(ids[i]);
+		ids[i] = spawn(world, i);
+	}
+	std::shuffle(ids.begin(), ids.end(), engine);
+	for (size_t i = 0; i < size / 4; ++i) {
+		world.remove_entity(ids.back());
+		ids.pop_back();
+	}
+	return ids;
+}
+
+// churn scatters the systems: joins jump around the columns and the holes
+// are walked over; optimize() packs and re-sorts them by entity index
+template <class World>
+void bench_optimize(const std::string &name, size_t size) {
+	World world;
+	const auto ids = spawn_scattered(world, size);
+
+	const auto repeat = repeat_for(size);
+	const auto join = [&] {
+		float sum = 0;
+		for (size_t r = 0; r < repeat; ++r) {
+			world.template each<suite_position, suite_velocity, suite_health>(
+				[&](ecs::entity_id, float &x, float &y, const float &vx, const float &vy, const int &) {
+					x += vx;
+					y += vy;
+					sum += x;
+				}
+			);
+		}
+		return sum;
+	};
+
+	const auto live = std::max<size_t>(ids.size(), 1);
+	float sum = 0;
+	report(name, size, "join_scattered", measure(live * repeat, [&] { sum += join(); }),
+		static_cast<double>(world.memory_usage()) / live);
+
+	const auto optimize = measure(live, [&] { world.optimize(); });
+	report(name, size, "optimize", optimize, static_cast<double>(world.memory_usage()) / live);
+
+	report(name, size, "join_optimized", measure(live * repeat, [&] { sum += join(); }));
+
+	// the same world optimized 100us per frame; the longest frame
+	{
+		World sliced;
+		spawn_scattered(sliced, size);
+
+		double longest = 0;
+		for (bool done = false; !done;) {
+			longest = std::max(longest, measure(1, [&] { done = sliced.optimize(std::chrono::microseconds(100)); }));
+		}
+		report(name, size, "optimize_100us_max", longest);
+	}
+
+	if (sum < 0) {
+		std::cout << sum << std::endl;
+	}
+}
+
+void bench_optimizes() {
+	section("bench_optimize");
+
+	for (auto size : sizes()) {
+		bench_optimize<suite_world<ecs::sparse_storage>>("world<sparse>", size);
+		bench_optimize<suite_world<ecs::packed_storage>>("world<packed>", size);
+		bench_optimize<suite_world<ecs::paged_storage>>("world<paged>", size);
+	}
+
+	end_section();
+}
+
+// boids spread at a constant density, moved a little every frame
+void bench_spatial_grid() {
+	section("bench_spatial_grid");
+
+	using boid_system = ecs::packed_system<float, float>;
+	using boid_world = ecs::world<boid_system>;
+	using grid_type = ecs::spatial_grid<float>;
+
+	constexpr float radius = 8.0f;
+	constexpr size_t brute_force_limit = 10000;
+
+	for (auto size : sizes()) {
+		const auto side = std::sqrt(static_cast<float>(size)) * 32.0f;
+		std::mt19937 engine(static_cast<unsigned int>(size));
+		std::uniform_real_distribution<float> position(0.0f, side);
+		std::uniform_real_distribution<float> step(-4.0f, 4.0f);
+
+		boid_world world;
+		world.reserve(size);
+		for (size_t i = 0; i < size; ++i) {
+			world.make_entity().emplace_component<0>(position(engine), position(engine));
+		}
+		auto &system = world.get_system<0>();
+
+		grid_type grid(radius * 4);
+		const auto build = measure(size, [&] {
+			grid.update_from<1, 2>(system, radius, radius);
+		});
+		report("spatial_grid", size, "build", build, static_cast<double>(grid.memory_usage()) / size);
+
+		auto &xs = system.get_members<1>();
+		auto &ys = system.get_members<2>();
+		for (size_t i = 0; i < size; ++i) {
+			xs[i] += step(engine);
+			ys[i] += step(engine);
+		}
+		report("spatial_grid", size, "update_from", measure(size, [&] {
+			grid.update_from<1, 2>(system, radius, radius);
+		}));
+
+		size_t found = 0;
+		report("spatial_grid", size, "query_radius", measure(size, [&] {
+			for (size_t i = 0; i < size; ++i) {
+				grid.query_radius(xs[i], ys[i], radius * 4, [&](ecs::entity_id, const grid_type::bounds_type &) { ++found; });
+			}
+		}));
+
+		size_t pairs = 0;
+		report("spatial_grid", size, "overlapping_pairs", measure(size, [&] {
+			grid.each_overlapping_pair([&](ecs::entity_id, ecs::entity_id) { ++pairs; });
+		}));
+
+		if (size <= brute_force_limit) {
+			size_t brute_pairs = 0;
+			report("brute_force", size, "overlapping_pairs", measure(size, [&] {
+				for (size_t i = 0; i < size; ++i) {
+					const auto a = grid_type::bounds_type::centered(xs[i], ys[i], radius, radius);
+					for (size_t j = i + 1; j < size; ++j) {
+						if (a.overlaps(grid_type::bounds_type::centered(xs[j], ys[j], radius, radius))) {
+							++brute_pairs;
+						}
+					}
+				}
+			}));
+			if (brute_pairs != pairs) {
+				std::cout << "pair count mismatch: " << pairs << " != " << brute_pairs << std::endl;
+			}
+		}
+
+		if (found == 0) {
+			std::cout << found << std::endl;
+		}
+	}
+
+	end_section();
+}
+
+// the type-erased wrapper flappy_boid used to store every game object in
+class actor {
+public:
+	using pointer = std::shared_ptr<actor>;
+	using update_function = std::function<bool(double)>;
+
+	actor(update_function &&fn) : _update_function(std::move(fn)) {}
+	virtual ~actor() {}
+
+	bool invoke(double delta_time) {
+		return _update_function ? _update_function(delta_time) : false;
+	}
+
+private:
+	update_function _update_function;
+};
+
+// bounces inside a box; never dies so every run touches the same entities
+struct mover {
+	float x;
+	float y;
+	float velocity_x;
+	float velocity_y;
+
+	bool update(double dt) {
+		x += velocity_x * static_cast<float>(dt);
+		y += velocity_y * static_cast<float>(dt);
+		if ((x < 0) || (x > 640)) velocity_x = -velocity_x;
+		if ((y < 0) || (y > 480)) velocity_y = -velocity_y;
+		return true;
+	}
+
+	// what the actor wrapper calls
+	bool operator()(double dt) {
+		return update(dt);
+	}
+};
+
+void bench_behaviours() {
+	section("bench_behaviours");
+
+	using actor_world = ecs::world<ecs::packed_system<actor::pointer>>;
+	using mover_world = ecs::world<ecs::packed_system<mover>>;
+
+	// a shared_ptr, a std::function and a copy per actor; 10M of them do not
+	// tell anything 1M does not
+	constexpr size_t max_size = 1000000;
+	constexpr double dt = 1.0 / 60.0;
+
+	for (auto size : sizes()) {
+		if (size > max_size) break;
+
+		std::mt19937 engine(static_cast<unsigned int>(size));
+		std::uniform_real_distribution<float> position(0.0f, 480.0f);
+		std::uniform_real_distribution<float> velocity(-100.0f, 100.0f);
+
+		std::vector<mover> movers(size);
+		for (auto &m : movers) {
+			m = { position(engine), position(engine), velocity(engine), velocity(engine) };
+		}
+
+		const auto repeat = repeat_for(size);
+
+		actor_world actors;
+		actors.reserve(size);
+		for (const auto &m : movers) {
+			actors.make_entity().emplace_component<0>(std::make_shared<actor>(mover(m)));
+		}
+		report("actor", size, "update", measure(size * repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				actors.invoke_system<0>([&](auto &world, auto &system) {
+					const auto &entities = system.entities();
+					auto &values = system.template get_members<1>();
+					for (size_t i = entities.size(); i-- > 0;) {
+						if (!values[i]->invoke(dt)) {
+							world.remove_entity(entities[i]);
+						}
+					}
+				});
+			}
+		}));
+
+		mover_world values;
+		values.reserve(size);
+		for (const auto &m : movers) {
+			values.make_entity().emplace_component<0>(mover(m));
+		}
+		report("behaviour", size, "update", measure(size * repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				values.update_behaviours<0>(dt);
+			}
+		}));
+	}
+
+	end_section();
+}
+
+void usage(const char *program) {
+	std::cout
+		<< "usage: " << program << " [--format table|csv|json] [--min-size N] [--max-size N] [--filter NAME]" << std::endl
+		<< "  sizes run from 1000 to 10000000 in steps of x10" << std::endl
+		<< "  NAME picks benchmarks whose name contains it, e.g. storages" << std::endl;
+}
+
+bool parse_options(int argc, char *argv[]) {
+	auto &options = settings();
+	for (int i = 1; i < argc; ++i) {
+		const std::string argument = argv[i];
+		const bool has_value = (i + 1 < argc);
+
+		if ((argument == "--format") && has_value) {
+			const std::string format = argv[++i];
+			if (format == "table") {
+				options.format = output_format::table;
+
+			} else if (format == "csv") {
+				options.format = output_format::csv;
+
+			} else if (format == "json") {
+				options.format = output_format::json;
+
+			} else {
+				return false;
+			}
+
+		} else if ((argument == "--min-size") && has_value) {
+			options.min_size = std::strtoull(argv[++i], nullptr, 10);
+
+		} else if ((argument == "--max-size") && has_value) {
+			options.max_size = std::strtoull(argv[++i], nullptr, 10);
+
+		} else if ((argument == "--filter") && has_value) {
+			options.filter = argv[++i];
+
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	if (!parse_options(argc, argv)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (settings().format == output_format::csv) {
+		std::cout << "name,size,operation,ns_per_op,ops_per_sec,bytes_per_entity" << std::endl;
+	}
+
+	if (enabled("entity_map")) bench_entity_map();
+	if (enabled("parallel_invoke")) bench_parallel_invoke();
+	if (enabled("world_layouts")) bench_world_layouts();
+	if (enabled("storages")) bench_storages();
+	if (enabled("optimize")) bench_optimizes();
+	if (enabled("spatial_grid")) bench_spatial_grid();
+	if (enabled("behaviours")) bench_behaviours();
+
+#if _DEBUG
+	system("pause");
+#endif
+
+	return 0;
+}
@@ -0,0 +1,111 @@
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+#include "flappy_boid/flappy_boid.hpp"
+
+namespace fb = flappy_boid;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct options {
+	size_t games = 64;
+	size_t boids = 100;
+	size_t steps = 60 * 60;
+	std::string controller = "heuristic";
+};
+
+// jumps when falling below the next gap
+bool heuristic(const fb::game &game, fb::ecs::entity_id, const fb::boid &boid) {
+	const auto seen = game.observe(boid);
+	return (seen.dy < -20) && (seen.velocity_y > 0);
+}
+
+// jumps on a per-boid rhythm, so the boids spread out
+bool scattered(const fb::game &game, fb::ecs::entity_id id, const fb::boid &boid) {
+	const auto phase = (game.steps() + fb::ecs::entity_index(id) * 7) % 23;
+	return (phase == 0) && (boid.velocity_y > 0);
+}
+
+template <class Controller>
+void run(const options &settings, Controller controller) {
+	fb::batch batch;
+	batch.setup(settings.games, settings.boids);
+
+	const auto begin = clock_type::now();
+	const auto steps = batch.run(controller, settings.steps);
+	const auto seconds = std::chrono::duration<double>(clock_type::now() - begin).count();
+
+	size_t alive = 0;
+	int best = 0;
+	double simulated = 0;
+	for (const auto &game : batch.games()) {
+		alive += game.alive_size();
+		best = std::max(best, game.score());
+		simulated += game.time();
+	}
+
+	std::cout
+		<< settings.controller << ": "
+		<< settings.games << " games x " << settings.boids << " boids, "
+		<< steps << " steps in " << std::fixed << std::setprecision(3) << seconds << " s" << std::endl
+		<< "  " << std::setprecision(0) << (steps / seconds) << " steps/s, "
+		<< (simulated / seconds) << "x real time" << std::endl
+		<< "  best score " << best << ", " << alive << " boids alive" << std::endl;
+}
+
+void usage(const char *program) {
+	std::cout << "usage: " << program << " [--games N] [--boids N] [--steps N] [--controller heuristic|scattered]" << std::endl;
+}
+
+bool parse_options(int argc, char *argv[], options &settings) {
+	for (int i = 1; i < argc; ++i) {
+		const std::string argument = argv[i];
+		if (i + 1 >= argc) return false;
+
+		if (argument == "--games") {
+			settings.games = std::strtoull(argv[++i], nullptr, 10);
+
+		} else if (argument == "--boids") {
+			settings.boids = std::strtoull(argv[++i], nullptr, 10);
+
+		} else if (argument == "--steps") {
+			settings.steps = std::strtoull(argv[++i], nullptr, 10);
+
+		} else if (argument == "--controller") {
+			settings.controller = argv[++i];
+
+		} else {
+			return false;
+		}
+	}
+	return (settings.controller == "heuristic") || (settings.controller == "scattered");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	options settings;
+	if (!parse_options(argc, argv, settings)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (settings.controller == "heuristic") {
+		run(settings, heuristic);
+
+	} else {
+		run(settings, scattered);
+	}
+
+#if _DEBUG
+	system("pause");
+#endif
+
+	return 0;
+}
@@ -10,23 +10,8 @@ namespace nn = neural_network;
 
 namespace {
 
-// j[
-class neuron : public nn::base_neuron<> {
-public:
-	neuron() : base_neuron(), _threshold(0) {}
-	neuron(const value_type &value) : base_neuron(value), _threshold(0) {}
-	neuron(const value_type &value, value_type threshold) : base_neuron(value), _threshold(threshold) {}
-
-	value_type threshold() const { return _threshold; }
-
-	void set_threshold(value_type threshold) { _threshold = threshold; }
-
-private:
-	value_type _threshold;
-};
-
-// lbg[N
-using network = nn::base_network<neuron>;
+// lbg[Nil̔zj
+using network = nn::packed_network;
 
 // C[
 constexpr network::layer_id_type input_layer = 0;
@@ -36,7 +21,7 @@ constexpr network::layer_id_type output_layer = 2;
 // eXgP[XNX
 class test_case {
 public:
-	using value_type = network::node_value_type;
+	using value_type = network::value_type;
 	using value_list_type = std::vector<value_type>;
 	using result_type = int;
 	using result_list_type = std::vector<result_type>;
@@ -49,32 +34,28 @@ public:
 	result_type test(network &network) {
 		network.reset();
 
-		auto &inputs = network.layer(input_layer);
-		const auto &outputs = network.layer(output_layer);
+		auto inputs = network.layer_values(input_layer);
+		std::copy(_input_list.begin(), _input_list.end(), inputs.begin());
 
-		for (size_t i = 0; i < _input_list.size(); ++i) {
-			auto node = inputs[i];
-			if (auto ptr = node.lock()) {
-				ptr->set_value(_input_list[i]);
-			}
-		}
+		network.process();
 
-		print_nodes(inputs);
+		return check(network.layer_values(output_layer));
+	}
 
-		std::cout << " -> ";
+	// o͂̔
+	result_type check(utility::span<const value_type> outputs) {
+		print_values(_input_list);
 
-		network.process();
+		std::cout << " -> ";
 
-		print_nodes(outputs);
+		print_values(outputs);
 
 		result_type ok = 0;
 
 		for (size_t i = 0; i < _answer_list.size(); ++i) {
-			if (auto ptr = outputs[i].lock()) {
-				if (ptr->value() != _answer_list[i]) {
-					ok = (ptr->value() > _answer_list[i]) ? 1 : -1;
-					break;
-				}
+			if (outputs[i] != _answer_list[i]) {
+				ok = (outputs[i] > _answer_list[i]) ? 1 : -1;
+				break;
 			}
 		}
 
@@ -91,24 +72,8 @@ public:
 	const value_list_type &answer_list() const { return _answer_list; }
 
 protected:
-	// m[hXg̏o
-	void print_nodes(network::layer_type nodes) {
-		std::cout << "[ ";
-
-		bool first = true;
-		for (auto node : nodes) {
-			if (auto ptr = node.lock()) {
-				if (!first) std::cout << ", ";
-				std::cout << ptr->value();
-				first = false;
-			}
-		}
-
-		std::cout << " ]";
-	}
-
 	// lXg̏o
-	void print_values(value_list_type values) {
+	void print_values(utility::span<const value_type> values) {
 		std::cout << "[ ";
 
 		bool first = true;
@@ -129,24 +94,25 @@ private:
 // eXgP[XXg
 using test_case_list_type = std::vector<test_case>;
 
-// eXg
-test_case::result_list_type test(network &network, test_case &test_case) {
+// eXgiSP[X܂Ƃ߂Đ_j
+test_case::result_list_type test(network &network, test_case_list_type &test_cases) {
 	::test_case::result_list_type results;
 
-	results.push_back(test_case.test(network));
+	const auto output_size = network.layer(::output_layer).size();
 
-	return std::move(results);
-}
+	::test_case::value_list_type inputs;
+	for (const auto &testcase : test_cases) {
+		inputs.insert(inputs.end(), testcase.input_list().begin(), testcase.input_list().end());
+	}
 
-// eXg
-test_case::result_list_type test(network &network, test_case_list_type &test_cases) {
-	::test_case::result_list_type results;
+	::test_case::value_list_type outputs(test_cases.size() * output_size);
+	network.process_batch(::input_layer, ::output_layer, inputs, outputs);
 
-	for (auto testcase : test_cases) {
-		results.push_back(testcase.test(network));
+	for (size_t i = 0; i < test_cases.size(); ++i) {
+		results.push_back(test_cases[i].check(utility::span<const float>(outputs.data() + i * output_size, output_size)));
 	}
 
-	return std::move(results);
+	return results;
 }
 
 // wK
@@ -164,10 +130,9 @@ void learn(network &network, const test_case &test_case, const test_case::result
 	);
 
 	// o̓m[ĥl𒲐
-	for (auto node : network.layer(::output_layer)) {
-		if (auto ptr = node.lock()) {
-			ptr->set_threshold((float)((int)ptr->threshold() + ((result > 0) ? 1 : -1)));
-		}
+	const auto &outputs = network.layer(::output_layer);
+	for (auto &value : network.activation_parameters().subspan(outputs.first, outputs.size())) {
+		value = (float)((int)value + ((result > 0) ? 1 : -1));
 	}
 }
 
@@ -179,10 +144,10 @@ void learn(network &network, const test_case_list_type &test_cases, const test_c
 }
 
 // m[h̏o
-void print_node(const network::node_pointer node) {
+void print_node(const network &network, network::node_id_type id) {
 	std::cout
-		<< "node { value = " << node->value()
-		<< ", threshold = " << node->threshold()
+		<< "node { value = " << network.value(id)
+		<< ", threshold = " << network.node_activation(id).parameter
 		<< " }"
 		<< std::endl;
 }
@@ -201,8 +166,8 @@ void print_connection(const network::connection_type &connection) {
 // lbg[N̏o
 void print_network(const network &network) {
 	std::cout << "---------- NETWORK BEGIN" << std::endl;
-	for (auto node : network.node_list()) {
-		print_node(node);
+	for (network::node_id_type id = 0; id < network.node_size(); ++id) {
+		print_node(network, id);
 	}
 	for (auto connection : network.connection_list()) {
 		print_connection(connection);
@@ -218,13 +183,6 @@ int main()
 
 	// }b`̔]
 	{
-		// Xebv֐i`j[j
-		network.set_activation_function(
-			[](auto x) {
-				return static_cast<float>((x->value() < x->threshold()) ? 0 : 1);
-			}
-		);
-
 		// ̓m[hiَqj
 		network.push_node(0, ::input_layer); // 0: 310 yen
 		network.push_node(1, ::input_layer); // 1: 220 yen
@@ -233,7 +191,10 @@ int main()
 		// o̓m[hi}b`j
 		// 0 = 
 		// 1 = Ȃ
-		network.push_node(3, ::output_layer, 0.0f, 6.f);// 3: total / 6 match
+		network.push_node(3, ::output_layer); // 3: total / 6 match
+
+		// Xebv֐i`j[jAp[^͂l
+		network.set_layer_activation(::output_layer, nn::activation_type::step, 6.f);
 
 		// ڑi}b`j
 		network.push_connection(0, 3, 1.f); // 1 match
@@ -0,0 +1,457 @@
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "neural_network/neural_network.hpp"
+
+namespace nn = neural_network;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+template <class F>
+double measure(size_t count, F fn) {
+	auto begin = clock_type::now();
+	fn();
+	auto end = clock_type::now();
+	return std::chrono::duration<double, std::nano>(end - begin).count() / static_cast<double>(count);
+}
+
+enum class output_format {
+	table,
+	csv,
+	json,
+};
+
+struct options {
+	output_format format = output_format::table;
+	size_t max_width = 512;
+	std::string filter;
+};
+
+options &settings() {
+	static options instance;
+	return instance;
+}
+
+bool enabled(const std::string &bench) {
+	return settings().filter.empty() || (bench.find(settings().filter) != std::string::npos);
+}
+
+// hidden layer widths; 8 is about the size of a flappy_boid controller
+std::vector<size_t> widths() {
+	std::vector<size_t> result;
+	for (size_t width = 8; width <= settings().max_width; width *= 4) {
+		result.push_back(width);
+	}
+	return result;
+}
+
+// one line per measurement; csv and json (one object per line) are for scripts
+void report(const std::string &name, size_t connections, const std::string &operation, double ns_per_op) {
+	const double ops_per_sec = (ns_per_op > 0) ? (1e9 / ns_per_op) : 0;
+
+	switch (settings().format) {
+	case output_format::table:
+		std::cout
+			<< std::left << std::setw(24) << name
+			<< std::right << std::setw(10) << connections << "  "
+			<< std::left << std::setw(20) << operation
+			<< std::right << std::setw(12) << std::fixed << std::setprecision(2) << ns_per_op << " ns/op"
+			<< std::setw(14) << std::setprecision(0) << ops_per_sec << " op/s"
+			<< std::endl;
+		break;
+
+	case output_format::csv:
+		std::cout
+			<< name << ',' << connections << ',' << operation << ','
+			<< std::fixed << std::setprecision(3) << ns_per_op << ','
+			<< std::setprecision(0) << ops_per_sec << std::endl;
+		break;
+
+	case output_format::json:
+		std::cout
+			<< "{\"name\":\"" << name << "\",\"connections\":" << connections << ",\"operation\":\"" << operation << "\""
+			<< ",\"ns_per_op\":" << std::fixed << std::setprecision(3) << ns_per_op
+			<< ",\"ops_per_sec\":" << std::setprecision(0) << ops_per_sec << "}" << std::endl;
+		break;
+	}
+}
+
+void section(const std::string &name) {
+	if (settings().format == output_format::table) {
+		std::cout << name << " ----------" << std::endl;
+	}
+}
+
+void end_section() {
+	if (settings().format == output_format::table) {
+		std::cout << std::endl;
+	}
+}
+
+// enough passes to measure about ten million connections
+size_t repeat_for(size_t connections) {
+	return std::max<size_t>(10000000 / connections, 10);
+}
+
+// a fully connected net: width inputs, two hidden layers of width, width / 4 outputs
+struct topology {
+	std::vector<size_t> sizes;
+	std::vector<nn::connection> connections;
+	std::vector<float> inputs;
+};
+
+topology make_topology(size_t width, unsigned int seed) {
+	std::mt19937 engine(seed);
+	std::uniform_real_distribution<float> weight(-1.0f, 1.0f);
+
+	topology result;
+	result.sizes = { width, width, width, std::max<size_t>(width / 4, 1) };
+
+	size_t first = 0;
+	for (size_t layer = 1; layer < result.sizes.size(); ++layer) {
+		const auto in_first = first;
+		first += result.sizes[layer - 1];
+		for (size_t out = 0; out < result.sizes[layer]; ++out) {
+			for (size_t in = 0; in < result.sizes[layer - 1]; ++in) {
+				result.connections.emplace_back(in_first + in, first + out, weight(engine));
+			}
+		}
+	}
+
+	result.inputs.resize(width);
+	for (auto &input : result.inputs) {
+		input = weight(engine);
+	}
+	return result;
+}
+
+template <class Network>
+void push_topology(Network &network, const topology &net) {
+	size_t id = 0;
+	for (size_t layer = 0; layer < net.sizes.size(); ++layer) {
+		for (size_t i = 0; i < net.sizes[layer]; ++i, ++id) {
+			network.push_node(static_cast<typename Network::node_id_type>(id), static_cast<int>(layer));
+		}
+	}
+	for (const auto &connection : net.connections) {
+		network.push_connection(connection);
+	}
+}
+
+float activate(float value) {
+	return std::tanh(value);
+}
+
+// the same nets as a node graph, as flat arrays and as dense matrices
+void bench_process() {
+	section("bench_process");
+
+	for (auto width : widths()) {
+		const auto net = make_topology(width, static_cast<unsigned int>(width));
+		const auto size = net.connections.size();
+		const auto repeat = repeat_for(size);
+		float sum = 0;
+
+		nn::network graph;
+		push_topology(graph, net);
+		graph.set_activation_function([](auto node) { return activate(node->value()); });
+		report("network", size, "process", measure(repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				graph.reset();
+				for (size_t i = 0; i < width; ++i) {
+					graph.node(static_cast<int>(i))->set_value(net.inputs[i]);
+				}
+				graph.process();
+				sum += graph.node(static_cast<int>(width))->value();
+			}
+		}));
+
+		nn::packed_network packed;
+		push_topology(packed, net);
+		packed.set_activation_function([](float value, auto) { return activate(value); });
+		report("packed_network", size, "process", measure(repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				packed.reset();
+				std::copy(net.inputs.begin(), net.inputs.end(), packed.layer_values(0).begin());
+				packed.process();
+				sum += packed.layer_values(3)[0];
+			}
+		}));
+
+		auto dense = nn::make_dense_network(packed, activate);
+		report("dense_network", size, "process", measure(repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				std::copy(net.inputs.begin(), net.inputs.end(), dense.inputs().begin());
+				dense.process();
+				sum += dense.outputs()[0];
+			}
+		}));
+
+		if (sum == 12345.0f) {
+			std::cout << sum << std::endl;
+		}
+	}
+
+	end_section();
+}
+
+// thousands of observations per call, as when scoring a whole population;
+// reported per sample
+void bench_batch() {
+	section("bench_batch");
+
+	constexpr size_t samples = 4096;
+	auto &pool = utility::thread_pool::shared();
+
+	for (auto width : widths()) {
+		const auto net = make_topology(width, static_cast<unsigned int>(width));
+		const auto size = net.connections.size();
+		const auto repeat = std::max<size_t>(repeat_for(size) / samples, 1);
+		const auto outputs = net.sizes.back();
+
+		std::mt19937 engine(static_cast<unsigned int>(width));
+		std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+		std::vector<float> inputs(samples * width);
+		for (auto &input : inputs) {
+			input = value(engine);
+		}
+		std::vector<float> results(samples * outputs);
+		float sum = 0;
+
+		nn::packed_network packed;
+		push_topology(packed, net);
+		packed.set_activation_function([](float value, auto) { return activate(value); });
+		report("packed_network", size, "process", measure(samples * repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				for (size_t sample = 0; sample < samples; ++sample) {
+					packed.reset();
+					std::copy(inputs.begin() + sample * width, inputs.begin() + (sample + 1) * width, packed.layer_values(0).begin());
+					packed.process();
+					std::copy(packed.layer_values(3).begin(), packed.layer_values(3).end(), results.begin() + sample * outputs);
+				}
+			}
+		}));
+		report("packed_network", size, "process_batch", measure(samples * repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				packed.process_batch(0, 3, inputs, results);
+			}
+		}));
+		report("packed_network", size, "process_batch/pool", measure(samples * repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				packed.process_batch(0, 3, inputs, results, &pool);
+			}
+		}));
+		sum += results[0];
+
+		auto dense = nn::make_dense_network(packed, activate);
+		report("dense_network", size, "process", measure(samples * repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				for (size_t sample = 0; sample < samples; ++sample) {
+					std::copy(inputs.begin() + sample * width, inputs.begin() + (sample + 1) * width, dense.inputs().begin());
+					dense.process();
+					std::copy(dense.outputs().begin(), dense.outputs().end(), results.begin() + sample * outputs);
+				}
+			}
+		}));
+		report("dense_network", size, "process_batch", measure(samples * repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				dense.process_batch(inputs, results);
+			}
+		}));
+		report("dense_network", size, "process_batch/pool", measure(samples * repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				dense.process_batch(inputs, results, &pool);
+			}
+		}));
+		sum += results[0];
+
+		if (sum == 12345.0f) {
+			std::cout << sum << std::endl;
+		}
+	}
+
+	end_section();
+}
+
+// tanh through the std::function against the built-in one, whole nets and
+// the bare array kernel
+void bench_activation() {
+	section("bench_activation");
+
+	{
+		constexpr size_t size = 4096;
+		const size_t repeat = 1000;
+		std::vector<float> values(size);
+		float sum = 0;
+		const float parameter = 0;
+
+		const std::function<float(float)> function = activate;
+		report("std::function", size, "tanh", measure(size * repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				for (auto &value : values) {
+					value = function(value + 0.5f);
+				}
+			}
+		}));
+		sum += values[0];
+
+		report("apply_activation", size, "tanh", measure(size * repeat, [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				for (auto &value : values) {
+					value += 0.5f;
+				}
+				nn::detail::apply_activation(nn::activation_type::tanh, values.data(), size, &parameter, 0);
+			}
+		}));
+		sum += values[0];
+
+		if (sum == 12345.0f) {
+			std::cout << sum << std::endl;
+		}
+	}
+
+	for (auto width : widths()) {
+		const auto net = make_topology(width, static_cast<unsigned int>(width));
+		const auto size = net.connections.size();
+		const auto repeat = repeat_for(size);
+		float sum = 0;
+
+		nn::network graph;
+		push_topology(graph, net);
+		auto run_graph = [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				graph.reset();
+				for (size_t i = 0; i < width; ++i) {
+					graph.node(static_cast<int>(i))->set_value(net.inputs[i]);
+				}
+				graph.process();
+				sum += graph.node(static_cast<int>(width))->value();
+			}
+		};
+		graph.set_activation_function([](auto node) { return activate(node->value()); });
+		graph.compile();
+		report("network", size, "process/function", measure(repeat, run_graph));
+		graph.set_activation(nn::activation_type::tanh);
+		graph.compile();
+		report("network", size, "process/builtin", measure(repeat, run_graph));
+
+		nn::packed_network packed;
+		push_topology(packed, net);
+		auto run_packed = [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				packed.reset();
+				std::copy(net.inputs.begin(), net.inputs.end(), packed.layer_values(0).begin());
+				packed.process();
+				sum += packed.layer_values(3)[0];
+			}
+		};
+		packed.set_activation_function([](float value, auto) { return activate(value); });
+		packed.compile();
+		report("packed_network", size, "process/function", measure(repeat, run_packed));
+		packed.set_activation(nn::activation_type::tanh);
+		packed.compile();
+		report("packed_network", size, "process/builtin", measure(repeat, run_packed));
+
+		auto dense = nn::make_dense_network(packed);
+		auto run_dense = [&] {
+			for (size_t r = 0; r < repeat; ++r) {
+				std::copy(net.inputs.begin(), net.inputs.end(), dense.inputs().begin());
+				dense.process();
+				sum += dense.outputs()[0];
+			}
+		};
+		dense.set_activation(nn::activation_type::custom);
+		dense.set_activation_function(activate);
+		report("dense_network", size, "process/function", measure(repeat, run_dense));
+		dense.set_activation(nn::activation_type::tanh);
+		report("dense_network", size, "process/builtin", measure(repeat, run_dense));
+
+		if (sum == 12345.0f) {
+			std::cout << sum << std::endl;
+		}
+	}
+
+	end_section();
+}
+
+void usage(const char *program) {
+	std::cout
+		<< "usage: " << program << " [--format table|csv|json] [--max-width N] [--filter NAME]" << std::endl
+		<< "  widths run from 8 to 512 in steps of x4" << std::endl
+		<< "  NAME picks benchmarks whose name contains it, e.g. batch" << std::endl;
+}
+
+bool parse_options(int argc, char *argv[]) {
+	auto &options = settings();
+	for (int i = 1; i < argc; ++i) {
+		const std::string argument = argv[i];
+		const bool has_value = (i + 1 < argc);
+
+		if ((argument == "--format") && has_value) {
+			const std::string format = argv[++i];
+			if (format == "table") {
+				options.format = output_format::table;
+
+			} else if (format == "csv") {
+				options.format = output_format::csv;
+
+			} else if (format == "json") {
+				options.format = output_format::json;
+
+			} else {
+				return false;
+			}
+
+		} else if ((argument == "--max-width") && has_value) {
+			options.max_width = std::strtoull(argv[++i], nullptr, 10);
+
+		} else if ((argument == "--filter") && has_value) {
+			options.filter = argv[++i];
+
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	if (!parse_options(argc, argv)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (settings().format == output_format::csv) {
+		std::cout << "name,connections,operation,ns_per_op,ops_per_sec" << std::endl;
+	}
+
+	if (settings().format == output_format::table) {
+#if NEURAL_NETWORK_DENSE_AVX2
+		std::cout << "dense kernels: avx2" << std::endl << std::endl;
+#else
+		std::cout << "dense kernels: scalar" << std::endl << std::endl;
+#endif
+	}
+
+	if (enabled("process")) bench_process();
+	if (enabled("batch")) bench_batch();
+	if (enabled("activation")) bench_activation();
+
+#if _DEBUG
+	system("pause");
+#endif
+
+	return 0;
+}
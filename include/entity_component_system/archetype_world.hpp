@@ -0,0 +1,589 @@
+
+#ifndef ENTITY_COMPONENT_SYSTEM_ARCHETYPE_WORLD_HPP_
+#define ENTITY_COMPONENT_SYSTEM_ARCHETYPE_WORLD_HPP_
+
+#include <cstddef>
+#include <cstring>
+#include <array>
+#include <tuple>
+#include <vector>
+#include <memory>
+#include <new>
+#include <limits>
+#include <utility>
+#include <type_traits>
+#include <stdexcept>
+#include <unordered_map>
+#include <algorithm>
+
+#include "entity.hpp"
+#include "registry.hpp"
+
+namespace entity_component_system {
+
+namespace detail {
+
+template <class Component>
+struct component_values;
+
+template <class... Args>
+struct component_values<std::tuple<entity_id, Args...>> {
+	using type = std::tuple<Args...>;
+};
+
+} // namespace detail
+
+// alternative backend for the same Systems... as world
+// entities with the same set of components share an archetype, a table
+// split into fixed size chunks with one column per member, so queries over
+// common combinations stream linearly through memory
+// adding or removing a component moves the entity to another archetype
+template <class... Systems>
+class archetype_world {
+public:
+	using system_data = std::tuple<Systems...>;
+
+	template <std::size_t I>
+	using system = std::tuple_element_t<I, system_data>;
+
+	template <std::size_t I>
+	using component = typename system<I>::component;
+
+	// members of a component without its entity_id
+	template <std::size_t I>
+	using component_values = typename detail::component_values<component<I>>::type;
+
+	using registry_type = registry<sizeof...(Systems)>;
+	using entity_pool = typename registry_type::entity_pool;
+	using entity_list_type = typename registry_type::entity_list_type;
+	using signature_type = typename registry_type::signature_type;
+
+	static constexpr std::size_t chunk_size = 16 * 1024;
+	static constexpr std::size_t column_alignment = 64;
+	static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+	static constexpr std::size_t system_size() { return sizeof...(Systems); }
+
+	class entity {
+	public:
+		using world = entity_component_system::archetype_world<Systems...>;
+
+		template <size_t I>
+		using system = typename world::template system<I>;
+
+		template <size_t I>
+		using component = typename world::template component<I>;
+
+	public:
+		entity(world &w, entity_id id) : _world(w), _id(id) {}
+
+		entity(const entity &other) = delete;
+		entity(entity &&other) : _world(other._world), _id(other._id) {}
+
+		entity &operator=(const entity &other) = delete;
+		entity &operator=(entity &&other) = default;
+
+		operator entity_id() const { return id(); }
+
+		entity_id id() const { return _id; }
+
+		bool alive() const { return _world.is_alive(_id); }
+
+		template <size_t I = 0>
+		void add_component(component<I> &&initializer) {
+			_world.template add_component<I>(_id, std::forward<component<I>>(initializer));
+		}
+
+		template <size_t I = 0, class... Args>
+		void emplace_component(Args&&... args) {
+			_world.template emplace_component<I>(_id, std::forward<Args>(args)...);
+		}
+
+		template <size_t I = 0>
+		void remove_component() {
+			_world.template remove_component<I>(_id);
+		}
+
+		template <size_t I = 0>
+		decltype(auto) get_component() const {
+			return _world.template get_component<I>(_id);
+		}
+
+		template <size_t I = 0>
+		decltype(auto) get_component() {
+			return _world.template get_component<I>(_id);
+		}
+
+		void destroy() {
+			_world.remove_entity(_id);
+			_id = invalid_entity_id;
+		}
+
+	private:
+		world &_world;
+		entity_id _id;
+	};
+
+protected:
+	static constexpr std::size_t member_counts[] = { std::tuple_size_v<typename detail::component_values<typename Systems::component>::type>... };
+
+	template <std::size_t I>
+	static constexpr std::size_t member_offset() {
+		std::size_t offset = 0;
+		for (std::size_t i = 0; i < I; ++i) {
+			offset += member_counts[i];
+		}
+		return offset;
+	}
+
+	template <std::size_t... Is>
+	static constexpr std::size_t member_size(std::index_sequence<Is...>) {
+		return (std::size_t(0) + ... + std::tuple_size_v<component_values<Is>>);
+	}
+
+public:
+	static constexpr std::size_t member_size() { return member_size(std::index_sequence_for<Systems...>()); }
+
+protected:
+	// type-erased operations on one member column
+	// trivial members are moved with memcpy and never destroyed
+	struct member_info {
+		std::size_t system;
+		std::size_t size;
+		bool trivial;
+		void (*move)(void *to, void *from);
+		void (*destroy)(void *p);
+	};
+
+	template <class T>
+	static member_info make_member_info(std::size_t system) {
+		static_assert(alignof(T) <= column_alignment, "archetype_world columns are aligned to cache lines only");
+
+		return {
+			system,
+			sizeof(T),
+			std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+			[](void *to, void *from) { new (to) T(std::move(*static_cast<T *>(from))); },
+			[](void *p) { static_cast<T *>(p)->~T(); },
+		};
+	}
+
+	static void move_member(const member_info &info, void *to, void *from) {
+		if (info.trivial) {
+			std::memcpy(to, from, info.size);
+
+		} else {
+			info.move(to, from);
+		}
+	}
+
+	static void destroy_member(const member_info &info, void *p) {
+		if (!info.trivial) {
+			info.destroy(p);
+		}
+	}
+
+	template <std::size_t I, std::size_t... Ms>
+	static void add_member_infos(std::vector<member_info> &infos, std::index_sequence<Ms...>) {
+		using expander = int[];
+		(void)expander {
+			0, (infos.push_back(make_member_info<std::tuple_element_t<Ms, component_values<I>>>(I)), 0)...
+		};
+	}
+
+	template <std::size_t... Is>
+	static std::vector<member_info> make_member_infos(std::index_sequence<Is...>) {
+		std::vector<member_info> infos;
+		using expander = int[];
+		(void)expander {
+			0, (add_member_infos<Is>(infos, std::make_index_sequence<std::tuple_size_v<component_values<Is>>>()), 0)...
+		};
+		return infos;
+	}
+
+	static const std::vector<member_info> &member_infos() {
+		static const auto infos = make_member_infos(std::index_sequence_for<Systems...>());
+		return infos;
+	}
+
+	template <class From, class T>
+	using like_const = std::conditional_t<std::is_const<From>::value, const T, T>;
+
+	struct alignas(column_alignment) cache_line {
+		unsigned char bytes[column_alignment];
+	};
+
+	using chunk_pointer = std::unique_ptr<cache_line[]>;
+
+	struct archetype {
+		signature_type signature;
+
+		// byte offset of each member column in a chunk, npos when absent
+		std::vector<std::size_t> offsets;
+
+		// sizeof each member, 0 when absent
+		std::vector<std::size_t> strides;
+
+		// members present in this archetype
+		std::vector<std::size_t> members;
+
+		std::size_t capacity = 0;
+		std::size_t chunk_bytes = 0;
+		std::size_t size = 0;
+		std::vector<chunk_pointer> chunks;
+
+		// cached transitions to the archetype with one system added / removed
+		std::array<std::size_t, sizeof...(Systems)> add_edges;
+		std::array<std::size_t, sizeof...(Systems)> remove_edges;
+
+		unsigned char *column(std::size_t row, std::size_t offset) const {
+			return reinterpret_cast<unsigned char *>(chunks[row / capacity].get()) + offset;
+		}
+
+		entity_id &entity_at(std::size_t row) const {
+			return reinterpret_cast<entity_id *>(column(row, 0))[row % capacity];
+		}
+
+		void *member_at(std::size_t row, std::size_t member) const {
+			return column(row, offsets[member]) + (row % capacity) * strides[member];
+		}
+	};
+
+	using archetype_pointer = std::unique_ptr<archetype>;
+
+	struct location {
+		std::size_t archetype = npos;
+		std::size_t row = 0;
+	};
+
+public:
+	archetype_world() {}
+
+	archetype_world(const archetype_world &) = delete;
+	archetype_world &operator=(const archetype_world &) = delete;
+
+	~archetype_world() {
+		clear();
+	}
+
+public:
+	const entity_list_type &entities() const { return _registry.entities(); }
+
+	size_t entity_size() const { return entities().size(); }
+
+	bool is_alive(entity_id id) const { return _registry.alive(id); }
+
+	const entity_pool &pool() const { return _registry.pool(); }
+
+	const registry_type &entity_registry() const { return _registry; }
+
+	const signature_type &signature(entity_id id) const { return _registry.signature(id); }
+
+	size_t archetype_size() const { return _archetypes.size(); }
+
+	// bytes held by the registry, the chunks and the bookkeeping
+	std::size_t memory_usage() const {
+		std::size_t bytes = _registry.memory_usage() + _locations.capacity() * sizeof(location);
+		for (const auto &a : _archetypes) {
+			bytes += sizeof(archetype) + a->chunks.size() * a->chunk_bytes;
+			bytes += (a->offsets.capacity() + a->strides.capacity() + a->members.capacity()) * sizeof(std::size_t);
+		}
+		return bytes;
+	}
+
+public:
+	entity make_entity() {
+		const auto id = _registry.create();
+		locate(id) = location();
+		return entity(*this, id);
+	}
+
+	void remove_entity(entity_id id) {
+		if (!is_alive(id)) return;
+
+		const auto at = locate(id);
+		if (at.archetype != npos) {
+			erase_row(*_archetypes[at.archetype], at.row);
+		}
+		_registry.destroy(id);
+	}
+
+	void clear() {
+		for (auto &a : _archetypes) {
+			for (std::size_t row = a->size; row-- > 0;) {
+				destroy_row(*a, row);
+			}
+			a->size = 0;
+			a->chunks.clear();
+		}
+		_registry.clear();
+	}
+
+	template <size_t I = 0>
+	void add_component(entity_id id, component<I> &&initializer) {
+		if (!is_alive(id) || has_component<I>(id)) return;
+
+		insert_component<I, 1>(id, initializer, std::make_index_sequence<std::tuple_size_v<component_values<I>>>());
+	}
+
+	template <size_t I = 0, class... Args>
+	void emplace_component(entity_id id, Args&&... args) {
+		if (!is_alive(id) || has_component<I>(id)) return;
+
+		component_values<I> values(std::forward<Args>(args)...);
+		insert_component<I, 0>(id, values, std::make_index_sequence<std::tuple_size_v<component_values<I>>>());
+	}
+
+	template <size_t I = 0>
+	void remove_component(entity_id id) {
+		if (!has_component<I>(id)) return;
+
+		auto to = signature(id);
+		to.reset(I);
+		migrate(id, transition(locate(id).archetype, I, false), to);
+		_registry.reset(id, I);
+	}
+
+	template <size_t I = 0>
+	bool has_component(entity_id id) const {
+		return _registry.test(id, I);
+	}
+
+	// std::tuple<entity_id &, Args &...> like system::get_component()
+	template <size_t I = 0>
+	decltype(auto) get_component(entity_id id) const {
+		return component_handle<I, const entity_id>(id, std::make_index_sequence<std::tuple_size_v<component_values<I>>>());
+	}
+
+	template <size_t I = 0>
+	decltype(auto) get_component(entity_id id) {
+		return component_handle<I, entity_id>(id, std::make_index_sequence<std::tuple_size_v<component_values<I>>>());
+	}
+
+	// fn(entity_id, members of Is...) for every entity that has all of Is
+	template <std::size_t... Is, class Function>
+	void each(Function &&f) {
+		each_chunk<Is...>(
+			[&](std::size_t count, const entity_id *ids, auto... columns) {
+				for (std::size_t i = 0; i < count; ++i) {
+					invoke_row(f, ids[i], i, columns...);
+				}
+			}
+		);
+	}
+
+	// fn(count, const entity_id *, pointer tuple of Is...) once per chunk
+	// each tuple holds one pointer per member, all valid for count rows
+	template <std::size_t... Is, class Function>
+	void each_chunk(Function &&f) {
+		signature_type mask;
+		using expander = int[];
+		(void)expander { 0, ((void)mask.set(Is), 0)... };
+
+		for (auto &a : _archetypes) {
+			if ((a->signature & mask) != mask) continue;
+
+			for (std::size_t first = 0; first < a->size; first += a->capacity) {
+				const auto count = std::min(a->capacity, a->size - first);
+				f(count, &a->entity_at(first), member_pointers<Is>(*a, first, std::make_index_sequence<std::tuple_size_v<component_values<Is>>>())...);
+			}
+		}
+	}
+
+protected:
+	location &locate(entity_id id) {
+		const auto index = entity_index(id);
+		if (index >= _locations.size()) {
+			_locations.resize(index + 1);
+		}
+		return _locations[index];
+	}
+
+	const location &locate(entity_id id) const {
+		return _locations[entity_index(id)];
+	}
+
+	// values holds the members from First on
+	template <std::size_t I, std::size_t First, class T, std::size_t... Ms>
+	void insert_component(entity_id id, T &values, std::index_sequence<Ms...>) {
+		auto to = signature(id);
+		to.set(I);
+
+		const auto from = locate(id).archetype;
+		const auto target = (from == npos) ? find_archetype(to) : transition(from, I, true);
+		migrate(id, target, to);
+
+		const auto &at = locate(id);
+		auto &a = *_archetypes[at.archetype];
+		using expander = int[];
+		(void)expander {
+			0, ((void)new (a.member_at(at.row, member_offset<I>() + Ms)) std::tuple_element_t<Ms, component_values<I>>(std::move(std::get<Ms + First>(values))), 0)...
+		};
+		(void)a;
+
+		_registry.set(id, I);
+	}
+
+	// Id is entity_id or const entity_id; members follow its constness
+	template <std::size_t I, class Id, std::size_t... Ms>
+	auto component_handle(entity_id id, std::index_sequence<Ms...>) const {
+		if (!has_component<I>(id)) {
+			throw std::out_of_range("archetype_world::get_component");
+		}
+
+		const auto &at = locate(id);
+		const auto &a = *_archetypes[at.archetype];
+		return std::tuple<Id &, like_const<Id, std::tuple_element_t<Ms, component_values<I>>> &...>(
+			a.entity_at(at.row),
+			*static_cast<std::tuple_element_t<Ms, component_values<I>> *>(a.member_at(at.row, member_offset<I>() + Ms))...
+		);
+	}
+
+	template <std::size_t I, std::size_t... Ms>
+	static auto member_pointers(const archetype &a, std::size_t first, std::index_sequence<Ms...>) {
+		return std::make_tuple(static_cast<std::tuple_element_t<Ms, component_values<I>> *>(a.member_at(first, member_offset<I>() + Ms))...);
+	}
+
+	template <class Function, class... Columns>
+	static void invoke_row(Function &f, entity_id id, std::size_t i, const Columns &... columns) {
+		std::apply(f, std::tuple_cat(std::tuple<entity_id>(id), row_of(columns, i, std::make_index_sequence<std::tuple_size_v<Columns>>())...));
+	}
+
+	template <class Column, std::size_t... Ms>
+	static auto row_of(const Column &column, std::size_t i, std::index_sequence<Ms...>) {
+		return std::tie(std::get<Ms>(column)[i]...);
+	}
+
+	std::size_t find_archetype(const signature_type &signature) {
+		auto it = _archetype_map.find(signature);
+		if (it != _archetype_map.end()) return it->second;
+
+		_archetypes.emplace_back(make_archetype(signature));
+		_archetype_map.emplace(signature, _archetypes.size() - 1);
+		return _archetypes.size() - 1;
+	}
+
+	std::size_t transition(std::size_t from, std::size_t system, bool add) {
+		auto &edges = add ? _archetypes[from]->add_edges : _archetypes[from]->remove_edges;
+		if (edges[system] == npos) {
+			auto signature = _archetypes[from]->signature;
+			signature.set(system, add);
+			const auto to = find_archetype(signature);
+			(add ? _archetypes[from]->add_edges : _archetypes[from]->remove_edges)[system] = to;
+		}
+		return (add ? _archetypes[from]->add_edges : _archetypes[from]->remove_edges)[system];
+	}
+
+	// columns are laid out back to back, each aligned to a cache line; the
+	// chunk holds as many rows as fit, at least one
+	static archetype_pointer make_archetype(const signature_type &signature) {
+		archetype_pointer a(new archetype);
+		a->signature = signature;
+		a->offsets.assign(member_size(), npos);
+		a->strides.assign(member_size(), 0);
+		a->add_edges.fill(npos);
+		a->remove_edges.fill(npos);
+
+		const auto &infos = member_infos();
+		std::size_t row_bytes = sizeof(entity_id);
+		std::size_t columns = 1;
+		for (const auto &info : infos) {
+			if (signature.test(info.system)) {
+				row_bytes += info.size;
+				++columns;
+			}
+		}
+
+		const auto padding = columns * column_alignment;
+		a->capacity = (chunk_size > padding) ? std::max<std::size_t>((chunk_size - padding) / row_bytes, 1) : 1;
+
+		auto align = [](std::size_t offset) {
+			return (offset + column_alignment - 1) / column_alignment * column_alignment;
+		};
+
+		std::size_t offset = align(sizeof(entity_id) * a->capacity);
+		for (std::size_t m = 0; m < infos.size(); ++m) {
+			if (signature.test(infos[m].system)) {
+				a->offsets[m] = offset;
+				a->strides[m] = infos[m].size;
+				a->members.push_back(m);
+				offset = align(offset + infos[m].size * a->capacity);
+			}
+		}
+		a->chunk_bytes = std::max(offset, column_alignment);
+
+		return a;
+	}
+
+	std::size_t push_row(archetype &a, entity_id id) {
+		if (a.size == a.chunks.size() * a.capacity) {
+			a.chunks.emplace_back(new cache_line[a.chunk_bytes / column_alignment]);
+		}
+		const auto row = a.size++;
+		a.entity_at(row) = id;
+		return row;
+	}
+
+	void destroy_row(archetype &a, std::size_t row) {
+		const auto &infos = member_infos();
+		for (auto m : a.members) {
+			destroy_member(infos[m], a.member_at(row, m));
+		}
+	}
+
+	// destroys the members of row, then moves the last row into the hole
+	void erase_row(archetype &a, std::size_t row) {
+		const auto &infos = member_infos();
+		destroy_row(a, row);
+
+		const auto last = a.size - 1;
+		if (row != last) {
+			for (auto m : a.members) {
+				move_member(infos[m], a.member_at(row, m), a.member_at(last, m));
+				destroy_member(infos[m], a.member_at(last, m));
+			}
+			const auto moved = a.entity_at(last);
+			a.entity_at(row) = moved;
+			locate(moved).row = row;
+		}
+		--a.size;
+
+		// keep one spare chunk to avoid thrashing at a chunk boundary
+		if ((a.chunks.size() > 1) && (a.size + a.capacity * 2 <= a.chunks.size() * a.capacity)) {
+			a.chunks.pop_back();
+		}
+	}
+
+	// moves the members the entity keeps into target; new members are left
+	// for the caller to construct
+	void migrate(entity_id id, std::size_t target, const signature_type &to) {
+		auto &at = locate(id);
+		auto &b = *_archetypes[target];
+		const auto row = push_row(b, id);
+
+		if (at.archetype != npos) {
+			auto &a = *_archetypes[at.archetype];
+			const auto &infos = member_infos();
+			for (auto m : a.members) {
+				if (to.test(infos[m].system)) {
+					move_member(infos[m], b.member_at(row, m), a.member_at(at.row, m));
+				}
+			}
+			erase_row(a, at.row);
+		}
+
+		auto &moved = locate(id);
+		moved.archetype = target;
+		moved.row = row;
+	}
+
+private:
+	registry_type _registry;
+	std::vector<location> _locations;
+	std::vector<archetype_pointer> _archetypes;
+	std::unordered_map<signature_type, std::size_t> _archetype_map;
+};
+
+} // namespace entity_component_system
+
+#endif // ENTITY_COMPONENT_SYSTEM_ARCHETYPE_WORLD_HPP_
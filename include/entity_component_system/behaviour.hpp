@@ -0,0 +1,53 @@
+
+#ifndef ENTITY_COMPONENT_SYSTEM_BEHAVIOUR_HPP_
+#define ENTITY_COMPONENT_SYSTEM_BEHAVIOUR_HPP_
+
+#include <type_traits>
+#include <utility>
+
+#include "entity.hpp"
+
+namespace entity_component_system {
+
+// a behaviour is a plain value with an update member, stored by value in a
+// system of its own (e.g. system<boid>) and called without any type erasure
+// by world::update_behaviours()
+//
+//   struct boid {
+//       double y;
+//       bool update(double dt);                  // false removes the entity
+//       bool update(entity_id id, double dt);    // the same, with the owner
+//   };
+//
+// update may also return void, in which case the entity is kept
+
+namespace detail {
+
+template <class T, class... Args>
+auto update_behaviour(T &value, entity_id id, int, Args&... args) -> decltype(value.update(id, args...)) {
+	return value.update(id, args...);
+}
+
+template <class T, class... Args>
+auto update_behaviour(T &value, entity_id, long, Args&... args) -> decltype(value.update(args...)) {
+	return value.update(args...);
+}
+
+// true when the behaviour is still alive
+template <class T, class... Args>
+bool invoke_behaviour(T &value, entity_id id, Args&... args) {
+	using result_type = decltype(update_behaviour(value, id, 0, args...));
+	if constexpr (std::is_void_v<result_type>) {
+		update_behaviour(value, id, 0, args...);
+		return true;
+
+	} else {
+		return static_cast<bool>(update_behaviour(value, id, 0, args...));
+	}
+}
+
+} // namespace detail
+
+} // namespace entity_component_system
+
+#endif // ENTITY_COMPONENT_SYSTEM_BEHAVIOUR_HPP_
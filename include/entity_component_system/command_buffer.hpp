@@ -0,0 +1,282 @@
+
+#ifndef ENTITY_COMPONENT_SYSTEM_COMMAND_BUFFER_HPP_
+#define ENTITY_COMPONENT_SYSTEM_COMMAND_BUFFER_HPP_
+
+#include <cstddef>
+#include <cassert>
+#include <atomic>
+#include <array>
+#include <tuple>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+
+#include "utility/for_each.hpp"
+
+#include "entity.hpp"
+
+namespace entity_component_system {
+
+template <class World>
+class command_queue;
+
+// structural changes recorded while systems are iterated
+// applied by command_queue::flush()
+template <class World, class = std::make_index_sequence<World::system_size()>>
+class command_buffer;
+
+template <class World, std::size_t... Is>
+class command_buffer<World, std::index_sequence<Is...>> {
+public:
+	using world_type = World;
+	using queue_type = command_queue<world_type>;
+	using entity_list_type = std::vector<entity_id>;
+
+	template <std::size_t I>
+	using component = typename world_type::template component<I>;
+
+	using component_lists_type = std::tuple<std::vector<component<Is>>...>;
+	using removal_lists_type = std::array<entity_list_type, sizeof...(Is)>;
+
+	friend queue_type;
+
+public:
+	explicit command_buffer(queue_type &queue) : _queue(queue) {}
+
+	command_buffer(const command_buffer &) = delete;
+	command_buffer &operator=(const command_buffer &) = delete;
+
+	// the id is reserved now, so it can be used by later commands
+	// see command_queue::reserve_ids() for creating from parallel jobs
+	entity_id create() {
+		const auto id = _queue.reserve();
+		if (id != invalid_entity_id) {
+			_created.push_back(id);
+		}
+		return id;
+	}
+
+	void destroy(entity_id id) {
+		_destroyed.push_back(id);
+	}
+
+	template <std::size_t I>
+	void add_component(entity_id id, component<I> &&initializer) {
+		std::get<0>(initializer) = id;
+		std::get<I>(_added).emplace_back(std::move(initializer));
+	}
+
+	template <std::size_t I, class... Args>
+	void emplace_component(entity_id id, Args&&... args) {
+		std::get<I>(_added).emplace_back(id, std::forward<Args>(args)...);
+	}
+
+	template <std::size_t I>
+	void remove_component(entity_id id) {
+		_removed[I].push_back(id);
+	}
+
+	bool empty() const {
+		bool added = false;
+		utility::for_each_in_tuple(_added, [&](const auto &list) { added = added || !list.empty(); });
+		return !added
+			&& _created.empty()
+			&& _destroyed.empty()
+			&& std::all_of(_removed.begin(), _removed.end(), [](const entity_list_type &list) { return list.empty(); });
+	}
+
+	void clear() {
+		_created.clear();
+		_destroyed.clear();
+		utility::for_each_in_tuple(_added, [](auto &list) { list.clear(); });
+		for (auto &list : _removed) {
+			list.clear();
+		}
+	}
+
+private:
+	queue_type &_queue;
+	entity_list_type _created;
+	entity_list_type _destroyed;
+	component_lists_type _added;
+	removal_lists_type _removed;
+};
+
+// one command_buffer per thread for a world
+// create() during a parallel frame takes its ids from a range set aside by
+// reserve_ids() at the last sync point, so it does not grow the world while
+// other jobs read it
+template <class World>
+class command_queue {
+public:
+	using world_type = World;
+	using buffer_type = command_buffer<world_type>;
+	using buffer_pointer = std::unique_ptr<buffer_type>;
+	using buffer_map_type = std::unordered_map<std::thread::id, buffer_pointer>;
+	using entity_list_type = std::vector<entity_id>;
+
+public:
+	explicit command_queue(world_type &world) : _world(world) {}
+
+	command_queue(const command_queue &) = delete;
+	command_queue &operator=(const command_queue &) = delete;
+
+	~command_queue() {
+		discard();
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (auto i = std::min(_next.load(), _spare.size()); i < _spare.size(); ++i) {
+			_world.remove_entity(_spare[i]);
+		}
+	}
+
+	// buffer of the calling thread
+	buffer_type &local() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto &buffer = _buffers[std::this_thread::get_id()];
+		if (!buffer) {
+			buffer.reset(new buffer_type(*this));
+		}
+		return *buffer;
+	}
+
+	// sets count ids aside for create(); call it at a sync point, before
+	// the jobs that create entities run; flush() tops the range up again
+	void reserve_ids(std::size_t count) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_spare_size = count;
+		refill();
+	}
+
+	// an id from the reserved range; past its end the world itself reserves
+	// the id, which is only safe while no other job touches the world
+	entity_id reserve() {
+		const auto next = _next.fetch_add(1, std::memory_order_relaxed);
+		if (next < _spare.size()) {
+			return _spare[next];
+		}
+		assert((_spare_size == 0) && "command_queue: more entities created than reserve_ids() set aside");
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _world.reserve_entity();
+	}
+
+	// applies every buffer in one sorted batch; call it at a sync point
+	// order: create, add, remove component, destroy
+	void flush() {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		entity_list_type entities;
+
+		gather(entities, [](buffer_type &buffer) -> entity_list_type & { return buffer._created; });
+		for (auto id : entities) {
+			_world.commit_entity(id);
+		}
+
+		flush_components(std::make_index_sequence<world_type::system_size()>());
+
+		gather(entities, [](buffer_type &buffer) -> entity_list_type & { return buffer._destroyed; });
+		for (auto id : entities) {
+			_world.remove_entity(id);
+		}
+
+		for (auto &buffer : _buffers) {
+			buffer.second->clear();
+		}
+		refill();
+	}
+
+	// drops every recorded command and releases the reserved ids
+	void discard() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (auto &buffer : _buffers) {
+			for (auto id : buffer.second->_created) {
+				_world.remove_entity(id);
+			}
+			buffer.second->clear();
+		}
+	}
+
+protected:
+	// drops the ids create() took and reserves new ones up to _spare_size
+	void refill() {
+		_spare.erase(_spare.begin(), _spare.begin() + std::min(_next.load(), _spare.size()));
+		_next = 0;
+		while (_spare.size() < _spare_size) {
+			const auto id = _world.reserve_entity();
+			if (id == invalid_entity_id) break;
+			_spare.push_back(id);
+		}
+	}
+
+	static bool entity_less(entity_id a, entity_id b) {
+		return entity_index(a) < entity_index(b);
+	}
+
+	template <class F>
+	void gather(entity_list_type &entities, F list_of) {
+		entities.clear();
+		for (auto &buffer : _buffers) {
+			auto &list = list_of(*buffer.second);
+			entities.insert(entities.end(), list.begin(), list.end());
+		}
+		std::sort(entities.begin(), entities.end(), entity_less);
+		entities.erase(std::unique(entities.begin(), entities.end()), entities.end());
+	}
+
+	template <std::size_t... Is>
+	void flush_components(std::index_sequence<Is...>) {
+		using expander = int[];
+		(void)expander { 0, (flush_added<Is>(), 0)... };
+		(void)expander { 0, (flush_removed<Is>(), 0)... };
+	}
+
+	template <std::size_t I>
+	void flush_added() {
+		using component_type = typename buffer_type::template component<I>;
+
+		std::vector<component_type> components;
+		for (auto &buffer : _buffers) {
+			auto &list = std::get<I>(buffer.second->_added);
+			std::move(list.begin(), list.end(), std::back_inserter(components));
+		}
+		std::stable_sort(
+			components.begin(),
+			components.end(),
+			[](const component_type &a, const component_type &b) {
+				return entity_less(std::get<0>(a), std::get<0>(b));
+			}
+		);
+		for (auto &component : components) {
+			const auto id = std::get<0>(component);
+			_world.template add_component<I>(id, std::move(component));
+		}
+	}
+
+	template <std::size_t I>
+	void flush_removed() {
+		entity_list_type entities;
+		gather(entities, [](buffer_type &buffer) -> entity_list_type & { return buffer._removed[I]; });
+		for (auto id : entities) {
+			_world.template remove_component<I>(id);
+		}
+	}
+
+private:
+	world_type &_world;
+	buffer_map_type _buffers;
+	std::mutex _mutex;
+
+	entity_list_type _spare;
+	std::atomic<std::size_t> _next { 0 };
+	std::size_t _spare_size = 0;
+};
+
+} // namespace entity_component_system
+
+#endif // ENTITY_COMPONENT_SYSTEM_COMMAND_BUFFER_HPP_
@@ -2,16 +2,46 @@
 #ifndef ENTITY_COMPONENT_SYSTEM_ENTITY_HPP_
 #define ENTITY_COMPONENT_SYSTEM_ENTITY_HPP_
 
+#include <cstddef>
+#include <cstdint>
 #include <limits>
 
 namespace entity_component_system {
 
+// entity_id = generation | index
+// 32bit: 8bit generation / 24bit index
+// 64bit: 32bit generation / 32bit index
+#if defined(ENTITY_COMPONENT_SYSTEM_64BIT_ENTITY_ID)
+using entity_id = unsigned long long;
+#else
 using entity_id = unsigned int;
+#endif
 
 enum const_entity_id : entity_id {
 	invalid_entity_id = std::numeric_limits<entity_id>::max()
 };
 
+constexpr std::size_t entity_index_bits = (sizeof(entity_id) >= 8) ? 32 : 24;
+constexpr std::size_t entity_generation_bits = (sizeof(entity_id) * 8) - entity_index_bits;
+
+constexpr entity_id entity_index_mask = (static_cast<entity_id>(1) << entity_index_bits) - 1;
+constexpr entity_id entity_generation_mask = (static_cast<entity_id>(1) << entity_generation_bits) - 1;
+
+constexpr entity_id entity_index(entity_id id) {
+	return id & entity_index_mask;
+}
+
+constexpr entity_id entity_generation(entity_id id) {
+	return (id >> entity_index_bits) & entity_generation_mask;
+}
+
+constexpr entity_id make_entity_id(entity_id index, entity_id generation) {
+	return ((generation & entity_generation_mask) << entity_index_bits) | (index & entity_index_mask);
+}
+
+// frame counter used for change tracking; 0 means "never"
+using tick_type = std::uint32_t;
+
 } // namespace entity_component_system
 
 #endif // ENTITY_COMPONENT_SYSTEM_ENTITY_HPP_
@@ -3,7 +3,17 @@
 #define ENTITY_COMPONENT_SYSTEM_HPP_
 
 #include "entity.hpp"
+#include "entity_map.hpp"
+#include "storage_policy.hpp"
+#include "statistics.hpp"
 #include "system.hpp"
+#include "registry.hpp"
+#include "view.hpp"
+#include "behaviour.hpp"
 #include "world.hpp"
+#include "scheduler.hpp"
+#include "command_buffer.hpp"
+#include "archetype_world.hpp"
+#include "spatial_grid.hpp"
 
 #endif // ENTITY_COMPONENT_SYSTEM_HPP_
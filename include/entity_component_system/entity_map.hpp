@@ -0,0 +1,222 @@
+
+#ifndef ENTITY_COMPONENT_SYSTEM_ENTITY_MAP_HPP_
+#define ENTITY_COMPONENT_SYSTEM_ENTITY_MAP_HPP_
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+#include <algorithm>
+
+#include "entity.hpp"
+
+namespace entity_component_system {
+
+// entity_id -> component index, looked up through a paged sparse array
+// (no hashing, no per-node allocation)
+// pages are addressed by entity_index(id); the owner checks the generation
+template <class T = std::size_t, std::size_t PageSize = 4096>
+class sparse_entity_map {
+public:
+	using key_type = entity_id;
+	using mapped_type = T;
+	using size_type = std::size_t;
+	using page_type = std::unique_ptr<mapped_type[]>;
+	using page_list_type = std::vector<page_type>;
+
+	static constexpr mapped_type npos = std::numeric_limits<mapped_type>::max();
+	static constexpr size_type page_size = PageSize;
+
+	static_assert((PageSize & (PageSize - 1)) == 0, "PageSize must be a power of two");
+
+public:
+	sparse_entity_map() = default;
+
+	sparse_entity_map(sparse_entity_map &&other) = default;
+	sparse_entity_map &operator=(sparse_entity_map &&other) = default;
+
+	sparse_entity_map(const sparse_entity_map &other) : _size(other._size) {
+		_pages.resize(other._pages.size());
+		for (size_type i = 0; i < other._pages.size(); ++i) {
+			if (other._pages[i]) {
+				_pages[i] = make_page();
+				std::copy_n(other._pages[i].get(), page_size, _pages[i].get());
+			}
+		}
+	}
+
+	sparse_entity_map &operator=(const sparse_entity_map &other) {
+		if (this != &other) {
+			sparse_entity_map copy(other);
+			*this = std::move(copy);
+		}
+		return *this;
+	}
+
+	mapped_type find(key_type key) const {
+		const auto page = page_index(key);
+		if (page >= _pages.size() || !_pages[page]) return npos;
+		return _pages[page][offset(key)];
+	}
+
+	bool contains(key_type key) const {
+		return find(key) != npos;
+	}
+
+	mapped_type at(key_type key) const {
+		const auto value = find(key);
+		if (value == npos) {
+			throw std::out_of_range("sparse_entity_map::at");
+		}
+		return value;
+	}
+
+	bool insert(key_type key, mapped_type value) {
+		auto &slot = ensure(key);
+		if (slot != npos) return false;
+		slot = value;
+		++_size;
+		return true;
+	}
+
+	void assign(key_type key, mapped_type value) {
+		auto &slot = ensure(key);
+		if (slot == npos) ++_size;
+		slot = value;
+	}
+
+	bool erase(key_type key) {
+		const auto page = page_index(key);
+		if (page >= _pages.size() || !_pages[page]) return false;
+		auto &slot = _pages[page][offset(key)];
+		if (slot == npos) return false;
+		slot = npos;
+		--_size;
+		return true;
+	}
+
+	void reserve(size_type size) {
+		const auto pages = (size + page_size - 1) / page_size;
+		if (pages > _pages.size()) {
+			_pages.resize(pages);
+		}
+	}
+
+	void clear() {
+		_pages.clear();
+		_size = 0;
+	}
+
+	size_type size() const { return _size; }
+	bool empty() const { return _size == 0; }
+
+	size_type page_count() const {
+		return static_cast<size_type>(std::count_if(_pages.begin(), _pages.end(), [](const page_type &page) { return static_cast<bool>(page); }));
+	}
+
+	// share of the allocated pages' slots in use
+	double load_factor() const {
+		const auto slots = page_count() * page_size;
+		return (slots > 0) ? static_cast<double>(_size) / slots : 0.0;
+	}
+
+	// bytes held by the page table and the pages
+	size_type memory_usage() const {
+		return _pages.capacity() * sizeof(page_type) + page_count() * page_size * sizeof(mapped_type);
+	}
+
+protected:
+	static size_type page_index(key_type key) { return static_cast<size_type>(entity_index(key)) / page_size; }
+	static size_type offset(key_type key) { return static_cast<size_type>(entity_index(key)) & (page_size - 1); }
+
+	static page_type make_page() {
+		page_type page(new mapped_type[page_size]);
+		std::fill_n(page.get(), page_size, npos);
+		return page;
+	}
+
+	mapped_type &ensure(key_type key) {
+		const auto page = page_index(key);
+		if (page >= _pages.size()) {
+			_pages.resize(page + 1);
+		}
+		if (!_pages[page]) {
+			_pages[page] = make_page();
+		}
+		return _pages[page][offset(key)];
+	}
+
+private:
+	page_list_type _pages;
+	size_type _size = 0;
+};
+
+// entity_id -> component index, backed by std::unordered_map
+// keyed by entity_index(id) like sparse_entity_map, so both storage policies
+// see an older generation of an index the same way; the owner checks the
+// generation
+template <class T = std::size_t>
+class hash_entity_map {
+public:
+	using key_type = entity_id;
+	using mapped_type = T;
+	using size_type = std::size_t;
+	using container_type = std::unordered_map<key_type, mapped_type>;
+
+	static constexpr mapped_type npos = std::numeric_limits<mapped_type>::max();
+
+public:
+	mapped_type find(key_type key) const {
+		auto it = _map.find(entity_index(key));
+		return (it != _map.end()) ? it->second : npos;
+	}
+
+	bool contains(key_type key) const {
+		return _map.find(entity_index(key)) != _map.end();
+	}
+
+	mapped_type at(key_type key) const {
+		return _map.at(entity_index(key));
+	}
+
+	bool insert(key_type key, mapped_type value) {
+		return _map.emplace(entity_index(key), value).second;
+	}
+
+	void assign(key_type key, mapped_type value) {
+		_map[entity_index(key)] = value;
+	}
+
+	bool erase(key_type key) {
+		return (_map.erase(entity_index(key)) > 0);
+	}
+
+	void reserve(size_type size) {
+		_map.reserve(size);
+	}
+
+	void clear() {
+		_map.clear();
+	}
+
+	size_type size() const { return _map.size(); }
+	bool empty() const { return _map.empty(); }
+
+	const container_type &container() const { return _map; }
+
+	double load_factor() const { return _map.load_factor(); }
+
+	// approximate: the bucket array plus one node (value and link) per entry
+	size_type memory_usage() const {
+		return _map.bucket_count() * sizeof(void *) + _map.size() * (sizeof(typename container_type::value_type) + sizeof(void *));
+	}
+
+private:
+	container_type _map;
+};
+
+} // namespace entity_component_system
+
+#endif // ENTITY_COMPONENT_SYSTEM_ENTITY_MAP_HPP_
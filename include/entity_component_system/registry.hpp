@@ -0,0 +1,202 @@
+
+#ifndef ENTITY_COMPONENT_SYSTEM_REGISTRY_HPP_
+#define ENTITY_COMPONENT_SYSTEM_REGISTRY_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <bitset>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "utility/generational_id_pool.hpp"
+
+#include "entity.hpp"
+
+namespace entity_component_system {
+
+// live entities as a dense list with back-indices, plus one component
+// signature (a bit per system) for each entity index
+template <std::size_t SignatureSize>
+class registry {
+public:
+	using entity_pool = utility::generational_id_pool<entity_id, entity_index_bits>;
+	using entity_list_type = std::vector<entity_id>;
+	using position_type = std::size_t;
+	using position_list_type = std::vector<position_type>;
+	using signature_type = std::bitset<SignatureSize>;
+	using signature_list_type = std::vector<signature_type>;
+
+	static constexpr std::size_t signature_size() { return SignatureSize; }
+
+	// position of a reserved entity that is not in the live list yet
+	static constexpr position_type npos = std::numeric_limits<position_type>::max();
+
+public:
+	registry() {}
+
+	const entity_list_type &entities() const { return _entities; }
+
+	std::size_t size() const { return _entities.size(); }
+
+	const entity_pool &pool() const { return _entity_pool; }
+
+	std::size_t free_size() const { return _entity_pool.free_size(); }
+
+	bool alive(entity_id id) const { return _entity_pool.valid(id); }
+
+	entity_id create() {
+		const auto id = reserve();
+		commit(id);
+		return id;
+	}
+
+	// appends count new live ids to out
+	void create_many(std::size_t count, entity_list_type &out) {
+		reserve_capacity(_entities.size() + count);
+		out.reserve(out.size() + count);
+		for (std::size_t i = 0; i < count; ++i) {
+			const auto id = create();
+			if (id == invalid_entity_id) break;
+			out.push_back(id);
+		}
+	}
+
+	// room for size live entities without reallocation
+	void reserve_capacity(std::size_t size) {
+		_entity_pool.reserve(size);
+		_entities.reserve(size);
+		_positions.reserve(size);
+		_signatures.reserve(size);
+	}
+
+	// allocates an id without adding it to the live list
+	entity_id reserve() {
+		const auto id = _entity_pool.allocate();
+		if (id == invalid_entity_id) return id;
+
+		const auto index = entity_index(id);
+		if (index >= _positions.size()) {
+			_positions.resize(index + 1);
+			_signatures.resize(index + 1);
+		}
+		_positions[index] = npos;
+		_signatures[index].reset();
+
+		return id;
+	}
+
+	// adds a reserved id to the live list
+	bool commit(entity_id id) {
+		if (!alive(id) || committed(id)) return false;
+
+		_positions[entity_index(id)] = _entities.size();
+		_entities.push_back(id);
+		return true;
+	}
+
+	bool committed(entity_id id) const {
+		return alive(id) && (_positions[entity_index(id)] != npos);
+	}
+
+	bool destroy(entity_id id) {
+		if (!alive(id)) return false;
+
+		const auto index = entity_index(id);
+		const auto position = _positions[index];
+		if (position != npos) {
+			const auto last = _entities.back();
+			_entities[position] = last;
+			_positions[entity_index(last)] = position;
+			_entities.pop_back();
+		}
+
+		_signatures[index].reset();
+		_entity_pool.free(id);
+
+		return true;
+	}
+
+	const signature_type &signature(entity_id id) const {
+		return _signatures[entity_index(id)];
+	}
+
+	bool test(entity_id id, std::size_t bit) const {
+		return alive(id) && signature(id).test(bit);
+	}
+
+	void set(entity_id id, std::size_t bit, bool value = true) {
+		if (alive(id)) {
+			_signatures[entity_index(id)].set(bit, value);
+		}
+	}
+
+	void reset(entity_id id, std::size_t bit) {
+		set(id, bit, false);
+	}
+
+	// restores a saved pool and live list; signatures start empty
+	// ids that are alive but not listed come back as reserved
+	// throws std::runtime_error, leaving the registry as it was, when the
+	// list and the pool do not agree
+	void assign(entity_pool pool, entity_list_type entities) {
+		const auto size = pool.generations().size();
+		const auto &indices = pool.indices();
+		if (indices.current_id() > size) {
+			throw std::runtime_error("entity_component_system::registry::assign: index pool past the generations");
+		}
+
+		// free indices are marked while the live list is checked against them
+		constexpr position_type freed = npos - 1;
+		position_list_type positions(size, npos);
+		for (auto index : indices.free_ids()) {
+			if ((index >= indices.current_id()) || (positions[index] != npos)) {
+				throw std::runtime_error("entity_component_system::registry::assign: bad free index");
+			}
+			positions[index] = freed;
+		}
+		for (position_type position = 0; position < entities.size(); ++position) {
+			const auto id = entities[position];
+			const auto index = entity_index(id);
+			if (!pool.valid(id) || (index >= indices.current_id()) || (positions[index] != npos)) {
+				throw std::runtime_error("entity_component_system::registry::assign: bad live entity");
+			}
+			positions[index] = position;
+		}
+		for (auto index : indices.free_ids()) {
+			positions[index] = npos;
+		}
+
+		_entity_pool = std::move(pool);
+		_entities = std::move(entities);
+		_positions = std::move(positions);
+		_signatures.assign(size, signature_type());
+	}
+
+	// bytes held by the pool, the live list, positions and signatures
+	std::size_t memory_usage() const {
+		return _entity_pool.generations().capacity() * sizeof(entity_id)
+			+ _entity_pool.free_size() * sizeof(entity_id)
+			+ _entities.capacity() * sizeof(entity_id)
+			+ _positions.capacity() * sizeof(position_type)
+			+ _signatures.capacity() * sizeof(signature_type);
+	}
+
+	void clear() {
+		_entities.clear();
+		for (auto &signature : _signatures) {
+			signature.reset();
+		}
+		_entity_pool.clear();
+	}
+
+private:
+	entity_pool _entity_pool;
+	entity_list_type _entities;
+	position_list_type _positions;
+	signature_list_type _signatures;
+};
+
+} // namespace entity_component_system
+
+#endif // ENTITY_COMPONENT_SYSTEM_REGISTRY_HPP_
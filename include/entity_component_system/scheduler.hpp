@@ -0,0 +1,213 @@
+
+#ifndef ENTITY_COMPONENT_SYSTEM_SCHEDULER_HPP_
+#define ENTITY_COMPONENT_SYSTEM_SCHEDULER_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <bitset>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <exception>
+#include <thread>
+#include <chrono>
+
+#include "utility/thread_pool.hpp"
+
+namespace entity_component_system {
+
+// system indices a job reads / writes
+template <std::size_t... Is>
+struct reads {
+	template <std::size_t N>
+	static std::bitset<N> signature() {
+		std::bitset<N> bits;
+		using expander = int[];
+		(void)expander { 0, ((void)bits.set(Is), 0)... };
+		return bits;
+	}
+};
+
+template <std::size_t... Is>
+struct writes {
+	template <std::size_t N>
+	static std::bitset<N> signature() {
+		return reads<Is...>::template signature<N>();
+	}
+};
+
+// runs jobs on a thread pool once per frame
+// a job waits for every earlier job it conflicts with (write/read,
+// read/write or write/write on the same system); the rest run in parallel
+// without any per-entity locking
+template <class World>
+class scheduler {
+public:
+	using world_type = World;
+	using signature_type = std::bitset<world_type::system_size()>;
+	using job_function = std::function<void(world_type &)>;
+	using job_id = std::size_t;
+
+	struct job_type {
+		signature_type reads;
+		signature_type writes;
+		bool exclusive;
+		job_function function;
+	};
+
+	using job_list_type = std::vector<job_type>;
+	using frame_type = std::shared_future<void>;
+
+public:
+	explicit scheduler(utility::thread_pool &pool = utility::thread_pool::shared()) : _pool(pool) {}
+
+	job_id add_job(const signature_type &reads, const signature_type &writes, job_function fn) {
+		_jobs.push_back({ reads, writes, false, std::move(fn) });
+		_dirty = true;
+		return _jobs.size() - 1;
+	}
+
+	template <class Reads, class Writes = entity_component_system::writes<>, class F>
+	job_id add_job(F &&fn) {
+		constexpr auto size = world_type::system_size();
+		return add_job(Reads::template signature<size>(), Writes::template signature<size>(), std::forward<F>(fn));
+	}
+
+	// conflicts with every other job, e.g. for structural changes
+	template <class F>
+	job_id add_exclusive_job(F &&fn) {
+		_jobs.push_back({ signature_type(), signature_type(), true, std::forward<F>(fn) });
+		_dirty = true;
+		return _jobs.size() - 1;
+	}
+
+	void clear() {
+		_jobs.clear();
+		_dirty = true;
+	}
+
+	const job_list_type &jobs() const { return _jobs; }
+
+	std::size_t job_size() const { return _jobs.size(); }
+
+	// starts one frame; the returned future becomes ready when every job is done
+	// the job list must not change until then
+	frame_type run(world_type &world) {
+		std::promise<void> done;
+		frame_type frame = done.get_future().share();
+
+		if (_jobs.empty()) {
+			done.set_value();
+			return frame;
+		}
+
+		build();
+
+		auto state = std::make_shared<frame_state>();
+		state->world = &world;
+		state->jobs = &_jobs;
+		state->dependents = &_dependents;
+		state->counts.reset(new std::atomic<std::size_t>[_jobs.size()]);
+		for (std::size_t i = 0; i < _jobs.size(); ++i) {
+			state->counts[i].store(_dependency_counts[i], std::memory_order_relaxed);
+		}
+		state->left.store(_jobs.size(), std::memory_order_relaxed);
+		state->done = std::move(done);
+
+		for (std::size_t i = 0; i < _jobs.size(); ++i) {
+			if (_dependency_counts[i] == 0) {
+				launch(state, i);
+			}
+		}
+
+		return frame;
+	}
+
+	// helps the pool until frame is complete; rethrows a job's exception
+	void wait(const frame_type &frame) {
+		while (frame.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			if (!_pool.run_pending_task()) {
+				std::this_thread::yield();
+			}
+		}
+		frame.get();
+	}
+
+	// runs a frame and helps the pool until it is complete
+	void run_and_wait(world_type &world) {
+		wait(run(world));
+	}
+
+protected:
+	struct frame_state {
+		world_type *world;
+		const job_list_type *jobs;
+		const std::vector<std::vector<job_id>> *dependents;
+		std::unique_ptr<std::atomic<std::size_t>[]> counts;
+		std::atomic<std::size_t> left;
+		std::promise<void> done;
+		std::exception_ptr error;
+		std::atomic<bool> failed { false };
+	};
+
+	static bool conflicts(const job_type &a, const job_type &b) {
+		if (a.exclusive || b.exclusive) return true;
+		return (a.writes & (b.reads | b.writes)).any() || (a.reads & b.writes).any();
+	}
+
+	void build() {
+		if (!_dirty) return;
+
+		_dependents.assign(_jobs.size(), {});
+		_dependency_counts.assign(_jobs.size(), 0);
+		for (std::size_t j = 0; j < _jobs.size(); ++j) {
+			for (std::size_t i = 0; i < j; ++i) {
+				if (conflicts(_jobs[i], _jobs[j])) {
+					_dependents[i].push_back(j);
+					++_dependency_counts[j];
+				}
+			}
+		}
+		_dirty = false;
+	}
+
+	void launch(const std::shared_ptr<frame_state> &state, job_id id) {
+		_pool.push([this, state, id] {
+			try {
+				(*state->jobs)[id].function(*state->world);
+
+			} catch (...) {
+				if (!state->failed.exchange(true)) {
+					state->error = std::current_exception();
+				}
+			}
+
+			for (auto dependent : (*state->dependents)[id]) {
+				if (state->counts[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					launch(state, dependent);
+				}
+			}
+
+			if (state->left.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				if (state->error) {
+					state->done.set_exception(state->error);
+
+				} else {
+					state->done.set_value();
+				}
+			}
+		});
+	}
+
+private:
+	utility::thread_pool &_pool;
+	job_list_type _jobs;
+	std::vector<std::vector<job_id>> _dependents;
+	std::vector<std::size_t> _dependency_counts;
+	bool _dirty = true;
+};
+
+} // namespace entity_component_system
+
+#endif // ENTITY_COMPONENT_SYSTEM_SCHEDULER_HPP_
@@ -0,0 +1,587 @@
+
+#ifndef ENTITY_COMPONENT_SYSTEM_SNAPSHOT_HPP_
+#define ENTITY_COMPONENT_SYSTEM_SNAPSHOT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <tuple>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+
+#include "utility/paged_vector.hpp"
+#include "utility/mapped_file.hpp"
+
+#include "entity.hpp"
+#include "system.hpp"
+#include "world.hpp"
+
+namespace entity_component_system {
+
+// layout of a snapshot, all integers in host byte order
+//   header    magic, version, byte order mark, sizeof(entity_id), system count
+//   registry  generations, index pool, live entity list
+//   system    member count, entity column, member columns, index pool
+// a column is its element count and byte size followed by the data, which
+// starts on a 64 byte boundary so bulk columns can be used straight from a
+// mapping
+constexpr std::uint32_t snapshot_version = 1;
+
+class snapshot_writer {
+public:
+	explicit snapshot_writer(std::ostream &stream) : _stream(stream) {}
+
+	std::size_t position() const { return _position; }
+
+	void write_bytes(const void *data, std::size_t size) {
+		_stream.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+		_position += size;
+	}
+
+	template <class T>
+	void write_value(const T &value) {
+		static_assert(std::is_trivially_copyable<T>::value, "write_value needs a trivially copyable type");
+		write_bytes(&value, sizeof(T));
+	}
+
+	void align(std::size_t alignment) {
+		static const char zeros[64] = {};
+		while ((_position % alignment) != 0) {
+			write_bytes(zeros, std::min<std::size_t>(alignment - (_position % alignment), sizeof(zeros)));
+		}
+	}
+
+private:
+	std::ostream &_stream;
+	std::size_t _position = 0;
+};
+
+// throws std::runtime_error when the data ends early
+class snapshot_reader {
+public:
+	snapshot_reader(const void *data, std::size_t size) : _data(static_cast<const unsigned char *>(data)), _size(size) {}
+
+	const unsigned char *current() const { return _data + _position; }
+
+	std::size_t position() const { return _position; }
+
+	std::size_t size() const { return _size; }
+
+	void require(std::size_t size) const {
+		if ((_size - _position) < size) {
+			throw std::runtime_error("entity_component_system::snapshot: unexpected end of data");
+		}
+	}
+
+	void read_bytes(void *data, std::size_t size) {
+		require(size);
+		if (size > 0) {
+			std::memcpy(data, current(), size);
+		}
+		_position += size;
+	}
+
+	template <class T>
+	T read_value() {
+		static_assert(std::is_trivially_copyable<T>::value, "read_value needs a trivially copyable type");
+		T value;
+		read_bytes(&value, sizeof(T));
+		return value;
+	}
+
+	void skip(std::size_t size) {
+		require(size);
+		_position += size;
+	}
+
+	void align(std::size_t alignment) {
+		const auto misalignment = _position % alignment;
+		if (misalignment != 0) {
+			skip(alignment - misalignment);
+		}
+	}
+
+private:
+	const unsigned char *_data;
+	std::size_t _size;
+	std::size_t _position = 0;
+};
+
+// how a member type is written
+// bulk types are copied a whole column at a time and can be read in place
+// from a mapped snapshot; anything else needs a specialization with
+// bulk = false and its own write() / read()
+template <class T>
+struct serializer {
+	static constexpr bool bulk = std::is_trivially_copyable<T>::value;
+
+	static void write(snapshot_writer &writer, const T &value) {
+		static_assert(bulk, "specialize entity_component_system::serializer<T> for this type");
+		writer.write_value(value);
+	}
+
+	static void read(snapshot_reader &reader, T &value) {
+		static_assert(bulk, "specialize entity_component_system::serializer<T> for this type");
+		reader.read_bytes(&value, sizeof(T));
+	}
+};
+
+template <class CharT, class Traits, class Allocator>
+struct serializer<std::basic_string<CharT, Traits, Allocator>> {
+	static constexpr bool bulk = false;
+
+	static void write(snapshot_writer &writer, const std::basic_string<CharT, Traits, Allocator> &value) {
+		writer.write_value<std::uint64_t>(value.size());
+		writer.write_bytes(value.data(), value.size() * sizeof(CharT));
+	}
+
+	static void read(snapshot_reader &reader, std::basic_string<CharT, Traits, Allocator> &value) {
+		const auto size = static_cast<std::size_t>(reader.read_value<std::uint64_t>());
+		reader.require(size * sizeof(CharT));
+		value.resize(size);
+		reader.read_bytes(&value[0], size * sizeof(CharT));
+	}
+};
+
+namespace detail {
+
+constexpr std::size_t snapshot_alignment = 64;
+constexpr char snapshot_magic[8] = { 'E', 'C', 'S', 'S', 'N', 'A', 'P', '\0' };
+constexpr std::uint32_t snapshot_byte_order = 0x01020304;
+
+template <class T, class Allocator>
+void write_column_bytes(snapshot_writer &writer, const std::vector<T, Allocator> &column) {
+	if (!column.empty()) {
+		writer.write_bytes(column.data(), column.size() * sizeof(T));
+	}
+}
+
+template <class T, std::size_t PageBytes, std::size_t Alignment, std::size_t MaxSize>
+void write_column_bytes(snapshot_writer &writer, const utility::paged_vector<T, PageBytes, Alignment, MaxSize> &column) {
+	for (std::size_t p = 0; p < column.page_count(); ++p) {
+		const auto page = column.page(p);
+		writer.write_bytes(page.data(), page.size() * sizeof(T));
+	}
+}
+
+template <class T, class Allocator>
+void read_column_bytes(snapshot_reader &reader, std::vector<T, Allocator> &column, std::size_t count) {
+	column.resize(count);
+	if (count > 0) {
+		reader.read_bytes(column.data(), count * sizeof(T));
+	}
+}
+
+template <class T, std::size_t PageBytes, std::size_t Alignment, std::size_t MaxSize>
+void read_column_bytes(snapshot_reader &reader, utility::paged_vector<T, PageBytes, Alignment, MaxSize> &column, std::size_t count) {
+	column.resize(count);
+	for (std::size_t p = 0; p < column.page_count(); ++p) {
+		auto page = column.page(p);
+		reader.read_bytes(page.data(), page.size() * sizeof(T));
+	}
+}
+
+template <class Column>
+void write_column(snapshot_writer &writer, const Column &column) {
+	using value_type = typename Column::value_type;
+
+	writer.write_value<std::uint64_t>(column.size());
+
+	if constexpr (serializer<value_type>::bulk) {
+		writer.write_value<std::uint64_t>(column.size() * sizeof(value_type));
+		writer.align(snapshot_alignment);
+		write_column_bytes(writer, column);
+
+	} else {
+		std::ostringstream buffer(std::ios::binary);
+		snapshot_writer values(buffer);
+		for (const auto &value : column) {
+			serializer<value_type>::write(values, value);
+		}
+		const auto bytes = buffer.str();
+		writer.write_value<std::uint64_t>(bytes.size());
+		writer.align(snapshot_alignment);
+		writer.write_bytes(bytes.data(), bytes.size());
+	}
+}
+
+struct column_header {
+	std::size_t count;
+	std::size_t bytes;
+	const unsigned char *data;
+};
+
+// leaves the reader after the column
+inline column_header skip_column(snapshot_reader &reader) {
+	column_header header;
+	header.count = static_cast<std::size_t>(reader.read_value<std::uint64_t>());
+	header.bytes = static_cast<std::size_t>(reader.read_value<std::uint64_t>());
+	reader.align(snapshot_alignment);
+	header.data = reader.current();
+	reader.skip(header.bytes);
+	return header;
+}
+
+// a bulk column must hold exactly count values of T
+template <class T>
+void check_column_bytes(const column_header &header) {
+	if ((header.bytes % sizeof(T) != 0) || (header.bytes / sizeof(T) != header.count)) {
+		throw std::runtime_error("entity_component_system::snapshot: column size mismatch");
+	}
+}
+
+template <class Column>
+void read_column(snapshot_reader &reader, Column &column) {
+	using value_type = typename Column::value_type;
+
+	const auto header = skip_column(reader);
+	snapshot_reader values(header.data, header.bytes);
+
+	if constexpr (serializer<value_type>::bulk) {
+		check_column_bytes<value_type>(header);
+		read_column_bytes(values, column, header.count);
+
+	} else {
+		// grown value by value, so a corrupt count runs out of data before
+		// it runs out of memory
+		column.clear();
+		for (std::size_t i = 0; i < header.count; ++i) {
+			column.resize(i + 1);
+			serializer<value_type>::read(values, column[i]);
+		}
+	}
+}
+
+template <class Pool>
+void write_id_pool(snapshot_writer &writer, const Pool &pool) {
+	writer.write_value<std::uint64_t>(pool.current_id());
+	writer.write_value<std::uint64_t>(pool.free_size());
+	for (auto id : pool.free_ids()) {
+		// ids the pool gave up are left out
+		if (id < pool.current_id()) {
+			writer.write_value<std::uint64_t>(id);
+		}
+	}
+}
+
+template <class Pool>
+Pool read_id_pool(snapshot_reader &reader) {
+	using id_type = typename Pool::id_type;
+
+	const auto current = static_cast<id_type>(reader.read_value<std::uint64_t>());
+	const auto count = static_cast<std::size_t>(reader.read_value<std::uint64_t>());
+	reader.require(count * sizeof(std::uint64_t));
+
+	typename Pool::free_id_container free_ids;
+	for (std::size_t i = 0; i < count; ++i) {
+		free_ids.push_back(static_cast<id_type>(reader.read_value<std::uint64_t>()));
+	}
+
+	Pool pool;
+	pool.assign(current, std::move(free_ids));
+	return pool;
+}
+
+inline void write_header(snapshot_writer &writer, std::size_t system_size) {
+	writer.write_bytes(snapshot_magic, sizeof(snapshot_magic));
+	writer.write_value<std::uint32_t>(snapshot_version);
+	writer.write_value<std::uint32_t>(snapshot_byte_order);
+	writer.write_value<std::uint32_t>(sizeof(entity_id));
+	writer.write_value<std::uint32_t>(static_cast<std::uint32_t>(system_size));
+}
+
+inline void read_header(snapshot_reader &reader, std::size_t system_size) {
+	char magic[sizeof(snapshot_magic)];
+	reader.read_bytes(magic, sizeof(magic));
+	if (std::memcmp(magic, snapshot_magic, sizeof(magic)) != 0) {
+		throw std::runtime_error("entity_component_system::snapshot: not a snapshot");
+	}
+	if (reader.read_value<std::uint32_t>() != snapshot_version) {
+		throw std::runtime_error("entity_component_system::snapshot: unsupported version");
+	}
+	if (reader.read_value<std::uint32_t>() != snapshot_byte_order) {
+		throw std::runtime_error("entity_component_system::snapshot: byte order mismatch");
+	}
+	if (reader.read_value<std::uint32_t>() != sizeof(entity_id)) {
+		throw std::runtime_error("entity_component_system::snapshot: entity_id size mismatch");
+	}
+	if (reader.read_value<std::uint32_t>() != system_size) {
+		throw std::runtime_error("entity_component_system::snapshot: system count mismatch");
+	}
+}
+
+} // namespace detail
+
+// reads and writes the internals of systems and worlds
+struct snapshot_access {
+	template <class Storage, class... Args>
+	static void save(snapshot_writer &writer, const basic_system<Storage, Args...> &system) {
+		writer.write_value<std::uint32_t>(static_cast<std::uint32_t>(system.member_size()));
+		utility::for_each_in_tuple(
+			system.data(),
+			[&](const auto &members) {
+				detail::write_column(writer, members);
+			}
+		);
+		detail::write_id_pool(writer, system._component_index_pool);
+	}
+
+	// the entity map is rebuilt from the entity column, so any map type works
+	template <class Storage, class... Args>
+	static void load(snapshot_reader &reader, basic_system<Storage, Args...> &system) {
+		using system_type = basic_system<Storage, Args...>;
+
+		system.clear();
+
+		if (reader.read_value<std::uint32_t>() != system.member_size()) {
+			throw std::runtime_error("entity_component_system::snapshot: member count mismatch");
+		}
+		utility::for_each_in_tuple(
+			system.data(),
+			[&](auto &members) {
+				detail::read_column(reader, members);
+			}
+		);
+		system._component_index_pool = detail::read_id_pool<typename system_type::component_index_pool>(reader);
+
+		const auto &entities = system.entities();
+		utility::for_each_in_tuple(
+			system.data(),
+			[&](const auto &members) {
+				if (members.size() != entities.size()) {
+					throw std::runtime_error("entity_component_system::snapshot: column size mismatch");
+				}
+			}
+		);
+		if constexpr (!system_type::is_packed()) {
+			// a free index must be a hole, or allocate() would hand out a live slot
+			const auto &pool = system._component_index_pool;
+			if (pool.current_id() != entities.size()) {
+				throw std::runtime_error("entity_component_system::snapshot: bad component index pool");
+			}
+			for (auto index : pool.free_ids()) {
+				if ((index >= entities.size()) || (entities[index] != invalid_entity_id)) {
+					throw std::runtime_error("entity_component_system::snapshot: bad component index pool");
+				}
+			}
+		}
+
+		system.entity_map().reserve(entities.size());
+		for (std::size_t index = 0; index < entities.size(); ++index) {
+			if ((entities[index] != invalid_entity_id) && !system.register_entity(entities[index], index)) {
+				throw std::runtime_error("entity_component_system::snapshot: duplicate entity");
+			}
+		}
+	}
+
+	template <class... Systems>
+	static void save(snapshot_writer &writer, const world<Systems...> &world) {
+		const auto &pool = world._registry.pool();
+
+		detail::write_header(writer, sizeof...(Systems));
+		detail::write_column(writer, pool.generations());
+		detail::write_id_pool(writer, pool.indices());
+		detail::write_column(writer, world._registry.entities());
+
+		utility::for_each_in_tuple(
+			world._system_data,
+			[&](const auto &system) {
+				save(writer, system);
+			}
+		);
+	}
+
+	template <class... Systems>
+	static void load(snapshot_reader &reader, world<Systems...> &world) {
+		using world_type = entity_component_system::world<Systems...>;
+		using entity_pool = typename world_type::entity_pool;
+
+		world.clear();
+		try {
+			detail::read_header(reader, sizeof...(Systems));
+
+			typename entity_pool::generation_list generations;
+			detail::read_column(reader, generations);
+			auto indices = detail::read_id_pool<typename entity_pool::index_pool>(reader);
+			typename world_type::entity_list_type entities;
+			detail::read_column(reader, entities);
+
+			entity_pool pool;
+			pool.assign(std::move(generations), std::move(indices));
+			world._registry.assign(std::move(pool), std::move(entities));
+
+			utility::for_each_in_tuple(
+				world._system_data,
+				[&](auto &system) {
+					load(reader, system);
+				}
+			);
+			restore_signatures(world, std::index_sequence_for<Systems...>());
+
+		} catch (...) {
+			world.clear();
+			throw;
+		}
+	}
+
+protected:
+	template <class World, std::size_t... Is>
+	static void restore_signatures(World &world, std::index_sequence<Is...>) {
+		using expander = int[];
+		(void)expander {
+			0, (restore_signature<Is>(world), 0)...
+		};
+	}
+
+	template <std::size_t I, class World>
+	static void restore_signature(World &world) {
+		for (auto id : world.template get_system<I>().entities()) {
+			if (id != invalid_entity_id) {
+				world._registry.set(id, I);
+			}
+		}
+	}
+};
+
+template <class World>
+void save_snapshot(const World &world, std::ostream &stream) {
+	snapshot_writer writer(stream);
+	snapshot_access::save(writer, world);
+}
+
+template <class World>
+void save_snapshot(const World &world, const std::string &path) {
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	if (!stream) {
+		throw std::runtime_error("entity_component_system::save_snapshot: cannot open " + path);
+	}
+	save_snapshot(world, stream);
+	if (!stream) {
+		throw std::runtime_error("entity_component_system::save_snapshot: cannot write " + path);
+	}
+}
+
+// replaces the contents of world; on failure world is left empty
+template <class World>
+void load_snapshot(World &world, const void *data, std::size_t size) {
+	snapshot_reader reader(data, size);
+	snapshot_access::load(reader, world);
+}
+
+// maps the file, so bulk columns are a single memcpy each
+template <class World>
+void load_snapshot(World &world, const std::string &path) {
+	utility::mapped_file file(path);
+	load_snapshot(world, file.data(), file.size());
+}
+
+// read-only access to the columns of a mapped snapshot without loading it
+// bulk columns point straight into the mapping
+template <class World>
+class snapshot_view {
+public:
+	using world_type = World;
+
+	template <std::size_t I>
+	using system = typename world_type::template system<I>;
+
+	template <std::size_t I, std::size_t Member>
+	using member_type = typename std::tuple_element_t<Member, typename system<I>::data_type>::value_type;
+
+public:
+	explicit snapshot_view(const std::string &path) : _file(path) {
+		snapshot_reader reader(_file.data(), _file.size());
+		detail::read_header(reader, world_type::system_size());
+
+		detail::skip_column(reader);
+		skip_id_pool(reader);
+		_entities = detail::skip_column(reader);
+		check_column<entity_id>(_entities, _entities.count);
+
+		_columns.resize(world_type::system_size());
+		for (auto &columns : _columns) {
+			const auto member_size = reader.read_value<std::uint32_t>();
+			for (std::uint32_t member = 0; member < member_size; ++member) {
+				columns.push_back(detail::skip_column(reader));
+			}
+			skip_id_pool(reader);
+		}
+		check_systems(std::make_index_sequence<world_type::system_size()>());
+	}
+
+	// live entities in the order of world::entities()
+	std::size_t entity_size() const { return _entities.count; }
+
+	const entity_id *entities() const { return reinterpret_cast<const entity_id *>(_entities.data); }
+
+	// slots of system I, including invalid_entity_id holes
+	template <std::size_t I>
+	std::size_t slot_size() const { return _columns[I][0].count; }
+
+	template <std::size_t I, std::size_t Member>
+	const member_type<I, Member> *members() const {
+		static_assert(serializer<member_type<I, Member>>::bulk, "only bulk columns can be viewed in place");
+		return reinterpret_cast<const member_type<I, Member> *>(_columns[I][Member].data);
+	}
+
+	template <std::size_t I>
+	const entity_id *system_entities() const { return members<I, 0>(); }
+
+protected:
+	// the columns must match the types of the world, so members() can hand
+	// them out as they are; throws std::runtime_error like the loader
+	template <std::size_t... Is>
+	void check_systems(std::index_sequence<Is...>) const {
+		using expander = int[];
+		(void)expander {
+			0, (check_system<Is>(std::make_index_sequence<system<Is>::member_size()>()), 0)...
+		};
+	}
+
+	template <std::size_t I, std::size_t... Members>
+	void check_system(std::index_sequence<Members...>) const {
+		if (_columns[I].size() != sizeof...(Members)) {
+			throw std::runtime_error("entity_component_system::snapshot: member count mismatch");
+		}
+		using expander = int[];
+		(void)expander {
+			0, (check_column<member_type<I, Members>>(_columns[I][Members], _columns[I][0].count), 0)...
+		};
+	}
+
+	template <class T>
+	static void check_column(const detail::column_header &column, std::size_t count) {
+		if (column.count != count) {
+			throw std::runtime_error("entity_component_system::snapshot: column size mismatch");
+		}
+		if constexpr (serializer<T>::bulk) {
+			detail::check_column_bytes<T>(column);
+			if ((reinterpret_cast<std::uintptr_t>(column.data) % alignof(T)) != 0) {
+				throw std::runtime_error("entity_component_system::snapshot: misaligned column");
+			}
+		}
+	}
+
+	static void skip_id_pool(snapshot_reader &reader) {
+		reader.skip(sizeof(std::uint64_t));
+		const auto count = static_cast<std::size_t>(reader.read_value<std::uint64_t>());
+		reader.skip(count * sizeof(std::uint64_t));
+	}
+
+private:
+	utility::mapped_file _file;
+	detail::column_header _entities;
+	std::vector<std::vector<detail::column_header>> _columns;
+};
+
+} // namespace entity_component_system
+
+#endif // ENTITY_COMPONENT_SYSTEM_SNAPSHOT_HPP_
@@ -0,0 +1,408 @@
+
+#ifndef ENTITY_COMPONENT_SYSTEM_SPATIAL_GRID_HPP_
+#define ENTITY_COMPONENT_SYSTEM_SPATIAL_GRID_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <unordered_map>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+
+#include "entity.hpp"
+#include "entity_map.hpp"
+
+namespace entity_component_system {
+
+// axis aligned box, max inclusive
+template <class T>
+struct aabb {
+	T min_x;
+	T min_y;
+	T max_x;
+	T max_y;
+
+	static aabb centered(T x, T y, T half_width, T half_height) {
+		return { x - half_width, y - half_height, x + half_width, y + half_height };
+	}
+
+	bool overlaps(const aabb &other) const {
+		return (min_x <= other.max_x) && (other.min_x <= max_x) && (min_y <= other.max_y) && (other.min_y <= max_y);
+	}
+
+	// squared distance from (x, y) to the box, 0 inside
+	T distance_squared(T x, T y) const {
+		const T dx = std::max({ min_x - x, T(0), x - max_x });
+		const T dy = std::max({ min_y - y, T(0), y - max_y });
+		return dx * dx + dy * dy;
+	}
+};
+
+// uniform grid of boxes keyed by entity_id, for broadphase collision and
+// proximity queries
+// update() only touches the cells when a box crosses a cell boundary, so
+// moving entities are cheap to keep in sync frame to frame
+// queries are const and report each entity (or pair) once, without any
+// per-query scratch state, so they can run from several threads as long as
+// nothing is updated at the same time
+// pick a cell size around the typical box size; a box covering more than
+// max_box_cells cells is kept in a list of its own and tested against every
+// query instead
+template <class T = float>
+class spatial_grid {
+public:
+	using value_type = T;
+	using bounds_type = aabb<T>;
+	using cell_index = std::int32_t;
+	using cell_key = std::uint64_t;
+	using cell_type = std::vector<entity_id>;
+	using cell_map_type = std::unordered_map<cell_key, cell_type>;
+	using proxy_map_type = sparse_entity_map<std::size_t>;
+
+	static constexpr std::size_t npos = proxy_map_type::npos;
+
+	// cells covered by a box
+	struct cell_range {
+		cell_index min_x;
+		cell_index min_y;
+		cell_index max_x;
+		cell_index max_y;
+
+		bool operator==(const cell_range &other) const {
+			return (min_x == other.min_x) && (min_y == other.min_y) && (max_x == other.max_x) && (max_y == other.max_y);
+		}
+
+		bool operator!=(const cell_range &other) const { return !(*this == other); }
+
+		// saturates instead of wrapping for a range over the whole plane
+		std::size_t size() const {
+			const auto width = static_cast<std::uint64_t>(static_cast<std::int64_t>(max_x) - min_x + 1);
+			const auto height = static_cast<std::uint64_t>(static_cast<std::int64_t>(max_y) - min_y + 1);
+			if (width > std::numeric_limits<std::uint64_t>::max() / height) {
+				return std::numeric_limits<std::size_t>::max();
+			}
+			return static_cast<std::size_t>(std::min<std::uint64_t>(width * height, std::numeric_limits<std::size_t>::max()));
+		}
+	};
+
+	struct proxy_type {
+		entity_id id;
+		bounds_type bounds;
+		cell_range cells;
+		std::uint32_t sweep;
+	};
+
+	using proxy_list_type = std::vector<proxy_type>;
+
+public:
+	explicit spatial_grid(T cell_size = T(64), std::size_t max_box_cells = 1024) : _cell_size(cell_size), _inverse_cell_size(T(1) / cell_size), _max_box_cells(max_box_cells) {
+		if (!(cell_size > T(0))) {
+			throw std::invalid_argument("spatial_grid: cell_size must be positive");
+		}
+	}
+
+	T cell_size() const { return _cell_size; }
+
+	std::size_t max_box_cells() const { return _max_box_cells; }
+
+	std::size_t size() const { return _proxies.size(); }
+
+	bool empty() const { return _proxies.empty(); }
+
+	const proxy_list_type &proxies() const { return _proxies; }
+
+	bool contains(entity_id id) const { return find_proxy(id) != npos; }
+
+	const bounds_type &bounds(entity_id id) const {
+		const auto index = find_proxy(id);
+		if (index == npos) {
+			throw std::out_of_range("spatial_grid::bounds");
+		}
+		return _proxies[index].bounds;
+	}
+
+	// inserts id or moves it to bounds
+	// a box left by an older generation of the same entity index is erased
+	// throws std::invalid_argument when a bound is NaN
+	void update(entity_id id, const bounds_type &bounds) {
+		if (is_nan(bounds)) {
+			throw std::invalid_argument("spatial_grid::update: NaN bounds");
+		}
+
+		const auto cells = cells_of(bounds);
+		auto index = _proxy_map.find(id);
+		if ((index != npos) && (_proxies[index].id != id)) {
+			erase(_proxies[index].id);
+			index = npos;
+		}
+
+		if (index == npos) {
+			_proxy_map.assign(id, _proxies.size());
+			_proxies.push_back({ id, bounds, cells, _sweep });
+			link(id, cells);
+			return;
+		}
+
+		auto &proxy = _proxies[index];
+		proxy.bounds = bounds;
+		proxy.sweep = _sweep;
+		if (proxy.cells != cells) {
+			unlink(id, proxy.cells);
+			link(id, cells);
+			proxy.cells = cells;
+		}
+	}
+
+	bool erase(entity_id id) {
+		const auto index = find_proxy(id);
+		if (index == npos) return false;
+
+		unlink(id, _proxies[index].cells);
+
+		// swap and pop; only the moved proxy's map entry changes
+		const auto last = _proxies.size() - 1;
+		if (index != last) {
+			_proxies[index] = _proxies[last];
+			_proxy_map.assign(_proxies[index].id, index);
+		}
+		_proxies.pop_back();
+		_proxy_map.erase(id);
+		return true;
+	}
+
+	void clear() {
+		_cells.clear();
+		_oversized.clear();
+		_proxies.clear();
+		_proxy_map.clear();
+	}
+
+	// drops cells that were emptied by moves; they are kept otherwise so an
+	// entity going back and forth does not reallocate
+	void shrink() {
+		for (auto it = _cells.begin(); it != _cells.end();) {
+			if (it->second.empty()) {
+				it = _cells.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	// mirrors a system: a box centred on members X and Y per live component
+	// boxes not refreshed by this call (e.g. removed components) are erased
+	template <std::size_t X, std::size_t Y, class System>
+	void update_from(const System &system, T half_width, T half_height) {
+		++_sweep;
+
+		const auto &entities = system.template get_members<0>();
+		const auto &xs = system.template get_members<X>();
+		const auto &ys = system.template get_members<Y>();
+		for (std::size_t i = 0; i < entities.size(); ++i) {
+			const auto id = entities[i];
+			if (id == invalid_entity_id) continue;
+
+			update(id, bounds_type::centered(static_cast<T>(xs[i]), static_cast<T>(ys[i]), half_width, half_height));
+		}
+
+		for (std::size_t i = _proxies.size(); i-- > 0;) {
+			if (_proxies[i].sweep != _sweep) {
+				erase(_proxies[i].id);
+			}
+		}
+	}
+
+	// fn(id, bounds) for every box overlapping area; a NaN area overlaps
+	// nothing
+	template <class F>
+	void query(const bounds_type &area, F &&fn) const {
+		if (is_nan(area)) return;
+
+		const auto range = cells_of(area);
+
+		// a huge area is cheaper to answer from the proxies directly
+		if (range.size() > _cells.size()) {
+			for (const auto &proxy : _proxies) {
+				if (proxy.bounds.overlaps(area)) {
+					fn(proxy.id, proxy.bounds);
+				}
+			}
+			return;
+		}
+
+		for_each_cell(range, [&](cell_index x, cell_index y) {
+			const auto it = _cells.find(key_of(x, y));
+			if (it == _cells.end()) return;
+
+			for (auto id : it->second) {
+				const auto &proxy = _proxies[_proxy_map.find(id)];
+
+				// a box spanning several cells is reported by the first shared cell only
+				if ((x != std::max(proxy.cells.min_x, range.min_x)) || (y != std::max(proxy.cells.min_y, range.min_y))) continue;
+
+				if (proxy.bounds.overlaps(area)) {
+					fn(proxy.id, proxy.bounds);
+				}
+			}
+		});
+
+		for (auto id : _oversized) {
+			const auto &proxy = _proxies[_proxy_map.find(id)];
+			if (proxy.bounds.overlaps(area)) {
+				fn(proxy.id, proxy.bounds);
+			}
+		}
+	}
+
+	// fn(id, bounds) for every box within radius of (x, y)
+	template <class F>
+	void query_radius(T x, T y, T radius, F &&fn) const {
+		const auto radius_squared = radius * radius;
+		query(
+			bounds_type::centered(x, y, radius, radius),
+			[&](entity_id id, const bounds_type &bounds) {
+				if (bounds.distance_squared(x, y) <= radius_squared) {
+					fn(id, bounds);
+				}
+			}
+		);
+	}
+
+	// fn(a, b) once for every pair of overlapping boxes
+	// an oversized box is tested against every other box
+	template <class F>
+	void each_overlapping_pair(F &&fn) const {
+		for (const auto &cell : _cells) {
+			const auto x = static_cast<cell_index>(static_cast<std::uint32_t>(cell.first >> 32));
+			const auto y = static_cast<cell_index>(static_cast<std::uint32_t>(cell.first));
+			const auto &ids = cell.second;
+
+			for (std::size_t i = 0; i < ids.size(); ++i) {
+				const auto &a = _proxies[_proxy_map.find(ids[i])];
+				for (std::size_t j = i + 1; j < ids.size(); ++j) {
+					const auto &b = _proxies[_proxy_map.find(ids[j])];
+
+					// the pair shares several cells when both boxes span them
+					if ((x != std::max(a.cells.min_x, b.cells.min_x)) || (y != std::max(a.cells.min_y, b.cells.min_y))) continue;
+
+					if (a.bounds.overlaps(b.bounds)) {
+						fn(a.id, b.id);
+					}
+				}
+			}
+		}
+
+		for (std::size_t i = 0; i < _oversized.size(); ++i) {
+			const auto &a = _proxies[_proxy_map.find(_oversized[i])];
+			for (std::size_t j = i + 1; j < _oversized.size(); ++j) {
+				const auto &b = _proxies[_proxy_map.find(_oversized[j])];
+				if (a.bounds.overlaps(b.bounds)) {
+					fn(a.id, b.id);
+				}
+			}
+			for (const auto &b : _proxies) {
+				if (!is_oversized(b.cells) && a.bounds.overlaps(b.bounds)) {
+					fn(a.id, b.id);
+				}
+			}
+		}
+	}
+
+	std::size_t cell_count() const { return _cells.size(); }
+
+	// approximate, like hash_entity_map::memory_usage()
+	std::size_t memory_usage() const {
+		std::size_t bytes = _proxies.capacity() * sizeof(proxy_type) + _proxy_map.memory_usage();
+		bytes += _oversized.capacity() * sizeof(entity_id);
+		bytes += _cells.bucket_count() * sizeof(void *);
+		for (const auto &cell : _cells) {
+			bytes += sizeof(typename cell_map_type::value_type) + sizeof(void *) + cell.second.capacity() * sizeof(entity_id);
+		}
+		return bytes;
+	}
+
+protected:
+	std::size_t find_proxy(entity_id id) const {
+		const auto index = _proxy_map.find(id);
+		return ((index != npos) && (_proxies[index].id == id)) ? index : npos;
+	}
+
+	cell_index cell_of(T value) const {
+		const auto cell = std::floor(value * _inverse_cell_size);
+		const auto lowest = static_cast<T>(std::numeric_limits<cell_index>::min());
+		const auto highest = static_cast<T>(std::numeric_limits<cell_index>::max());
+		return static_cast<cell_index>(std::min(std::max(cell, lowest), highest));
+	}
+
+	cell_range cells_of(const bounds_type &bounds) const {
+		return { cell_of(bounds.min_x), cell_of(bounds.min_y), cell_of(bounds.max_x), cell_of(bounds.max_y) };
+	}
+
+	static bool is_nan(const bounds_type &bounds) {
+		return std::isnan(bounds.min_x) || std::isnan(bounds.min_y) || std::isnan(bounds.max_x) || std::isnan(bounds.max_y);
+	}
+
+	static cell_key key_of(cell_index x, cell_index y) {
+		return (static_cast<cell_key>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+	}
+
+	// fn(x, y) over the range; the counters are wider than a cell index, so
+	// a range ending at its maximum does not overflow them
+	template <class F>
+	static void for_each_cell(const cell_range &cells, F &&fn) {
+		for (std::int64_t y = cells.min_y; y <= cells.max_y; ++y) {
+			for (std::int64_t x = cells.min_x; x <= cells.max_x; ++x) {
+				fn(static_cast<cell_index>(x), static_cast<cell_index>(y));
+			}
+		}
+	}
+
+	bool is_oversized(const cell_range &cells) const {
+		return cells.size() > _max_box_cells;
+	}
+
+	void link(entity_id id, const cell_range &cells) {
+		if (is_oversized(cells)) {
+			_oversized.push_back(id);
+			return;
+		}
+		for_each_cell(cells, [&](cell_index x, cell_index y) {
+			_cells[key_of(x, y)].push_back(id);
+		});
+	}
+
+	static void remove_from(cell_type &ids, entity_id id) {
+		const auto it = std::find(ids.begin(), ids.end(), id);
+		if (it != ids.end()) {
+			*it = ids.back();
+			ids.pop_back();
+		}
+	}
+
+	void unlink(entity_id id, const cell_range &cells) {
+		if (is_oversized(cells)) {
+			remove_from(_oversized, id);
+			return;
+		}
+		for_each_cell(cells, [&](cell_index x, cell_index y) {
+			remove_from(_cells[key_of(x, y)], id);
+		});
+	}
+
+private:
+	T _cell_size;
+	T _inverse_cell_size;
+	std::size_t _max_box_cells;
+	cell_map_type _cells;
+	cell_type _oversized;
+	proxy_list_type _proxies;
+	proxy_map_type _proxy_map;
+	std::uint32_t _sweep = 0;
+};
+
+} // namespace entity_component_system
+
+#endif // ENTITY_COMPONENT_SYSTEM_SPATIAL_GRID_HPP_
@@ -0,0 +1,292 @@
+
+#ifndef ENTITY_COMPONENT_SYSTEM_STATISTICS_HPP_
+#define ENTITY_COMPONENT_SYSTEM_STATISTICS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <ostream>
+#include <algorithm>
+
+#include "entity.hpp"
+
+// define ENTITY_COMPONENT_SYSTEM_STATISTICS to time world::invoke_system()
+// without it the timers compile to nothing; occupancy and memory figures are
+// computed on request and always available
+
+namespace entity_component_system {
+
+// per-system invoke timings, in nanoseconds
+struct invoke_statistics {
+	std::uint64_t count = 0;
+	std::uint64_t total_ns = 0;
+	std::uint64_t last_ns = 0;
+	std::uint64_t max_ns = 0;
+};
+
+// occupancy of one system
+// slots counts holes left by removed components, live does not
+struct system_statistics {
+	std::size_t live = 0;
+	std::size_t slots = 0;
+	std::size_t capacity = 0;
+	std::size_t free_slots = 0;
+	double load_factor = 0.0;
+	std::size_t map_bytes = 0;
+	std::vector<std::size_t> column_bytes;
+	std::size_t bytes = 0;
+	invoke_statistics invokes;
+};
+
+struct world_statistics {
+	tick_type tick = 0;
+	std::size_t entities = 0;
+	std::size_t free_ids = 0;
+	std::size_t bytes = 0;
+	std::vector<system_statistics> systems;
+};
+
+// records invoke_system() calls and per-frame counters, written out in the
+// Chrome trace event format (chrome://tracing, Perfetto)
+class trace_recorder {
+public:
+	using clock_type = std::chrono::steady_clock;
+	using time_point = clock_type::time_point;
+
+	struct event_type {
+		std::size_t system;
+		std::size_t thread;
+		std::uint64_t start_ns;
+		std::uint64_t duration_ns;
+	};
+
+	struct frame_type {
+		std::uint64_t time_ns;
+		world_statistics statistics;
+	};
+
+public:
+	trace_recorder() : _epoch(clock_type::now()) {}
+
+	trace_recorder(const trace_recorder &) = delete;
+	trace_recorder &operator=(const trace_recorder &) = delete;
+
+	void record_invoke(std::size_t system, time_point start, time_point end) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_events.push_back({ system, thread_number(), since_epoch(start), elapsed(start, end) });
+	}
+
+	// occupancy counters of the world at this point
+	template <class World>
+	void record_frame(const World &world) {
+		auto statistics = world.statistics();
+		std::lock_guard<std::mutex> lock(_mutex);
+		_frames.push_back({ since_epoch(clock_type::now()), std::move(statistics) });
+	}
+
+	const std::vector<event_type> &events() const { return _events; }
+
+	const std::vector<frame_type> &frames() const { return _frames; }
+
+	void clear() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_events.clear();
+		_frames.clear();
+	}
+
+	void write(std::ostream &os) const {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		const char *separator = "\n";
+		os << "{\"traceEvents\":[";
+		for (const auto &event : _events) {
+			os << separator
+				<< "{\"name\":\"system " << event.system << "\",\"cat\":\"invoke\",\"ph\":\"X\",\"pid\":0"
+				<< ",\"tid\":" << event.thread
+				<< ",\"ts\":" << microseconds(event.start_ns)
+				<< ",\"dur\":" << microseconds(event.duration_ns) << "}";
+			separator = ",\n";
+		}
+		for (const auto &frame : _frames) {
+			const auto &statistics = frame.statistics;
+			os << separator
+				<< "{\"name\":\"world\",\"ph\":\"C\",\"pid\":0,\"ts\":" << microseconds(frame.time_ns)
+				<< ",\"args\":{\"entities\":" << statistics.entities
+				<< ",\"free_ids\":" << statistics.free_ids
+				<< ",\"bytes\":" << statistics.bytes << "}}";
+			separator = ",\n";
+
+			for (std::size_t i = 0; i < statistics.systems.size(); ++i) {
+				const auto &system = statistics.systems[i];
+				os << separator
+					<< "{\"name\":\"system " << i << "\",\"ph\":\"C\",\"pid\":0,\"ts\":" << microseconds(frame.time_ns)
+					<< ",\"args\":{\"live\":" << system.live
+					<< ",\"slots\":" << system.slots
+					<< ",\"bytes\":" << system.bytes << "}}";
+			}
+		}
+		os << "\n]}\n";
+	}
+
+protected:
+	std::uint64_t since_epoch(time_point time) const {
+		return (time > _epoch) ? elapsed(_epoch, time) : 0;
+	}
+
+	static std::uint64_t elapsed(time_point start, time_point end) {
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	}
+
+	static double microseconds(std::uint64_t ns) {
+		return static_cast<double>(ns) / 1000.0;
+	}
+
+	// small, stable numbers read better in trace viewers than hashed ids
+	std::size_t thread_number() {
+		const auto id = std::this_thread::get_id();
+		const auto it = std::find(_threads.begin(), _threads.end(), id);
+		if (it != _threads.end()) {
+			return static_cast<std::size_t>(it - _threads.begin());
+		}
+		_threads.push_back(id);
+		return _threads.size() - 1;
+	}
+
+private:
+	time_point _epoch;
+	std::vector<event_type> _events;
+	std::vector<frame_type> _frames;
+	std::vector<std::thread::id> _threads;
+	mutable std::mutex _mutex;
+};
+
+// invoke timers of a world, one per system
+// updated with relaxed atomics, so jobs reading the same system may run in parallel
+template <std::size_t N>
+class invoke_timers {
+public:
+#ifdef ENTITY_COMPONENT_SYSTEM_STATISTICS
+	using clock_type = trace_recorder::clock_type;
+
+	struct timer_type {
+		std::atomic<std::uint64_t> count { 0 };
+		std::atomic<std::uint64_t> total_ns { 0 };
+		std::atomic<std::uint64_t> last_ns { 0 };
+		std::atomic<std::uint64_t> max_ns { 0 };
+	};
+
+	// times the enclosing invoke until it goes out of scope
+	class scope {
+	public:
+		scope(invoke_timers &timers, std::size_t index) : _timers(timers), _index(index), _start(clock_type::now()) {}
+
+		scope(const scope &) = delete;
+		scope &operator=(const scope &) = delete;
+
+		~scope() {
+			_timers.record(_index, _start, clock_type::now());
+		}
+
+	private:
+		invoke_timers &_timers;
+		std::size_t _index;
+		clock_type::time_point _start;
+	};
+#else
+	// does nothing; user-provided so an unused scope is not warned about
+	struct scope {
+		scope() {}
+		~scope() {}
+	};
+#endif
+
+	static constexpr bool enabled() {
+#ifdef ENTITY_COMPONENT_SYSTEM_STATISTICS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+public:
+	invoke_timers() {}
+
+	// copies start with fresh timers and no recorder
+	invoke_timers(const invoke_timers &) {}
+	invoke_timers &operator=(const invoke_timers &) { return *this; }
+
+	scope make_scope(std::size_t index) {
+#ifdef ENTITY_COMPONENT_SYSTEM_STATISTICS
+		return scope(*this, index);
+#else
+		(void)index;
+		return scope();
+#endif
+	}
+
+	invoke_statistics get(std::size_t index) const {
+		invoke_statistics statistics;
+#ifdef ENTITY_COMPONENT_SYSTEM_STATISTICS
+		const auto &timer = _timers[index];
+		statistics.count = timer.count.load(std::memory_order_relaxed);
+		statistics.total_ns = timer.total_ns.load(std::memory_order_relaxed);
+		statistics.last_ns = timer.last_ns.load(std::memory_order_relaxed);
+		statistics.max_ns = timer.max_ns.load(std::memory_order_relaxed);
+#else
+		(void)index;
+#endif
+		return statistics;
+	}
+
+	void reset() {
+#ifdef ENTITY_COMPONENT_SYSTEM_STATISTICS
+		for (auto &timer : _timers) {
+			timer.count.store(0, std::memory_order_relaxed);
+			timer.total_ns.store(0, std::memory_order_relaxed);
+			timer.last_ns.store(0, std::memory_order_relaxed);
+			timer.max_ns.store(0, std::memory_order_relaxed);
+		}
+#endif
+	}
+
+	// invokes are also recorded as trace events while a recorder is set
+	void set_recorder(trace_recorder *recorder) {
+		_recorder = recorder;
+	}
+
+	trace_recorder *recorder() const { return _recorder; }
+
+#ifdef ENTITY_COMPONENT_SYSTEM_STATISTICS
+protected:
+	void record(std::size_t index, clock_type::time_point start, clock_type::time_point end) {
+		const auto ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+		auto &timer = _timers[index];
+		timer.count.fetch_add(1, std::memory_order_relaxed);
+		timer.total_ns.fetch_add(ns, std::memory_order_relaxed);
+		timer.last_ns.store(ns, std::memory_order_relaxed);
+
+		auto max = timer.max_ns.load(std::memory_order_relaxed);
+		while ((ns > max) && !timer.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+
+		if (_recorder) {
+			_recorder->record_invoke(index, start, end);
+		}
+	}
+
+private:
+	std::array<timer_type, N> _timers;
+#endif
+
+private:
+	trace_recorder *_recorder = nullptr;
+};
+
+} // namespace entity_component_system
+
+#endif // ENTITY_COMPONENT_SYSTEM_STATISTICS_HPP_
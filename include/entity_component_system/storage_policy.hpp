@@ -0,0 +1,67 @@
+
+#ifndef ENTITY_COMPONENT_SYSTEM_STORAGE_POLICY_HPP_
+#define ENTITY_COMPONENT_SYSTEM_STORAGE_POLICY_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "utility/paged_vector.hpp"
+#include "utility/aligned_allocator.hpp"
+
+#include "entity_map.hpp"
+
+namespace entity_component_system {
+
+enum class storage_layout {
+	// removed slots become invalid_entity_id holes and are reused later
+	stable,
+
+	// removal moves the last component into the hole (swap and pop)
+	packed,
+};
+
+// container of one member column; it starts on a cache line, so chunks of
+// basic_system::cache_line_stride() components never share one
+struct vector_column {
+	template <class T>
+	using type = std::vector<T, utility::aligned_allocator<T, 64>>;
+};
+
+// fixed size, cache line aligned pages, sized for every entity index;
+// growth never moves a component or the page directory, so workers may
+// index the components below a size they read earlier while one thread adds
+// components
+struct paged_column {
+	template <class T>
+	using type = utility::paged_vector<T, 16 * 1024, 64, (std::size_t(1) << entity_index_bits)>;
+};
+
+// Tracked keeps a change stamp per member slot, see basic_system::each_changed()
+// Buffered keeps a read-only front copy of the columns, see basic_system::publish()
+template <class EntityMap, storage_layout Layout = storage_layout::stable, class Column = vector_column, bool Tracked = false, bool Buffered = false>
+struct storage_policy {
+	using entity_map_type = EntityMap;
+	using column_policy = Column;
+
+	template <class T>
+	using column_type = typename column_policy::template type<T>;
+
+	static constexpr storage_layout layout = Layout;
+
+	static constexpr bool tracked = Tracked;
+
+	static constexpr bool buffered = Buffered;
+};
+
+using sparse_storage = storage_policy<sparse_entity_map<std::size_t>>;
+using hashed_storage = storage_policy<hash_entity_map<std::size_t>>;
+using packed_storage = storage_policy<sparse_entity_map<std::size_t>, storage_layout::packed>;
+using paged_storage = storage_policy<sparse_entity_map<std::size_t>, storage_layout::stable, paged_column>;
+using tracked_storage = storage_policy<sparse_entity_map<std::size_t>, storage_layout::stable, vector_column, true>;
+using buffered_storage = storage_policy<sparse_entity_map<std::size_t>, storage_layout::stable, vector_column, false, true>;
+
+using default_storage = sparse_storage;
+
+} // namespace entity_component_system
+
+#endif // ENTITY_COMPONENT_SYSTEM_STORAGE_POLICY_HPP_
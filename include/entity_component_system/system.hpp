@@ -2,29 +2,81 @@
 #ifndef ENTITY_COMPONENT_SYSTEM_SYSTEM_HPP_
 #define ENTITY_COMPONENT_SYSTEM_SYSTEM_HPP_
 
+#include <any>
+#include <array>
 #include <tuple>
 #include <vector>
-#include <unordered_map>
 #include <deque>
+#include <stdexcept>
+#include <numeric>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include <type_traits>
 
 #include "utility/id_pool.hpp"
+#include "utility/deadline.hpp"
 #include "utility/for_each.hpp"
 
+#include "entity.hpp"
+#include "storage_policy.hpp"
+#include "statistics.hpp"
+
 namespace entity_component_system {
 
-template <typename... Args>
-class system {
+struct snapshot_access;
+
+template <class Storage, typename... Args>
+class basic_system {
 public:
-	using entity_list = std::vector<entity_id>;
+	using storage_type = Storage;
+
+	template <class T>
+	using column_type = typename storage_type::template column_type<T>;
+
+	using entity_list = column_type<entity_id>;
 
-	using data_type = std::tuple<entity_list, std::vector<Args>...>;
+	using data_type = std::tuple<entity_list, column_type<Args>...>;
 
 	using component = std::tuple<entity_id, Args...>;
 	using component_view = std::tuple<entity_id &, Args &...>;
 	using component_index_type = std::size_t;
-	using component_index_pool = utility::id_pool<component_index_type>;
+	// lowest hole first, which keeps the columns dense and lets compact()
+	// fill the holes from the bottom up
+	using component_index_pool = utility::id_pool<
+		component_index_type,
+		std::numeric_limits<component_index_type>::min(),
+		std::numeric_limits<component_index_type>::max(),
+		true
+	>;
+
+	using entity_map_type = typename storage_type::entity_map_type;
+
+	using tick_type = entity_component_system::tick_type;
+	using tick_list = column_type<tick_type>;
+
+	// (tick, component index) in stamp order, one list per member
+	using change_list = std::vector<std::pair<tick_type, component_index_type>>;
+
+	static constexpr component_index_type npos = entity_map_type::npos;
+
+	friend snapshot_access;
 
-	using entity_map_type = std::unordered_map<entity_id, component_index_type>;
+	static constexpr bool is_packed() { return storage_type::layout == storage_layout::packed; }
+
+	static constexpr bool is_tracked() { return storage_type::tracked; }
+
+	static constexpr bool is_buffered() { return storage_type::buffered; }
+
+	static constexpr std::size_t cache_line_size = 64;
+
+	// number of components that keeps a chunk of every column on cache line boundaries
+	static constexpr std::size_t cache_line_stride() {
+		return std::max({ stride_of<entity_id>(), stride_of<Args>()... });
+	}
 
 	static constexpr size_t member_size() { return std::tuple_size_v<data_type>; }
 
@@ -34,7 +86,7 @@ public:
 	}
 
 public:
-	system() {}
+	basic_system() {}
 
 	template <class F>
 	decltype(auto) operator()(F &f) {
@@ -64,31 +116,131 @@ public:
 		return get_members<0>();
 	}
 
+	// slots in the columns, including holes left by removed components
 	size_t entity_size() const { return entities().size(); }
 
+	// components actually held
+	size_t live_size() const { return entity_map().size(); }
+
+	// holes waiting for reuse; always 0 for a packed system
+	size_t free_size() const { return _component_index_pool.free_size(); }
+
+	size_t capacity() const { return entities().capacity(); }
+
 public:
-	void add_component(entity_id id, component &&initializer) {
+	// false when id already has a component, which is left as it is
+	bool add_component(entity_id id, component &&initializer) {
+		remove_stale_component(id);
+
 		const auto index = allocate_component_index();
-		if (register_entity(id, index)) {
-			get_component_from_index(index) = initializer;
+		if (!register_entity(id, index)) {
+			free_component_index(index);
+			return false;
 		}
+		get_component_from_index(index) = std::move(initializer);
+		mark_all_changed(index);
+		return true;
+	}
+
+	bool add_component(entity_id id) {
+		return add_component(id, make_component());
 	}
 
-	void add_component(entity_id id) {
-		add_component(id, make_component());
+	bool emplace_component(entity_id id, Args&&... args) {
+		return add_component(id, make_component(id, std::forward<Args>(args)...));
 	}
 
-	void emplace_component(entity_id id, Args&&... args) {
-		add_component(id, make_component(id, std::forward<Args>(args)...));
+	void reserve(size_t size) {
+		utility::for_each_in_tuple(
+			data(),
+			[&](auto &members) {
+				members.reserve(size);
+			}
+		);
+		entity_map().reserve(size);
+	}
+
+	// appends one component per id in a single pass over each column
+	// columns are ranges with at least ids.size() values, one per member
+	// ids that already have a component are skipped
+	// a stable system with free indices fills them one component at a time,
+	// like emplace_component()
+	template <class Ids, class... Columns>
+	void emplace_range(const Ids &ids, const Columns &... columns) {
+		static_assert(sizeof...(Columns) == sizeof...(Args), "emplace_range needs one column per member");
+
+		const auto count = static_cast<size_t>(std::distance(std::begin(ids), std::end(ids)));
+		if (count == 0) return;
+
+		for (auto id : ids) {
+			remove_stale_component(id);
+		}
+
+		auto base = entity_size();
+		if constexpr (!is_packed()) {
+			if ((free_size() != 0) || (_component_index_pool.current_id() != base)) {
+				emplace_each(ids, std::begin(columns)...);
+				return;
+			}
+
+			base = _component_index_pool.allocate_range(count);
+			if (base == component_index_pool::max_id) {
+				throw std::length_error("entity_component_system::system::emplace_range");
+			}
+		}
+		reserve(base + count);
+
+		std::vector<size_t> rows;
+		rows.reserve(count);
+		{
+			size_t row = 0;
+			for (auto id : ids) {
+				if (register_entity(id, base + rows.size())) {
+					rows.push_back(row);
+				}
+				++row;
+			}
+		}
+		if constexpr (!is_packed()) {
+			// gives back the indices of skipped ids
+			_component_index_pool.assign(base + rows.size(), {});
+		}
+		if (rows.empty()) return;
+
+		const bool all = (rows.size() == count);
+		append_column(get_members<0>(), ids, count, rows, all);
+		append_columns(std::index_sequence_for<Args...>(), count, rows, all, columns...);
+
+		if constexpr (is_tracked()) {
+			for (auto index = base; index < entity_size(); ++index) {
+				mark_all_changed(index);
+			}
+		}
 	}
 
 	void remove_component(entity_id id) {
-		if (has_component(id)) {
-			auto index = get_component_index(id);
+		const auto index = find_component_index(id);
+		if (index == npos) return;
+
+		// the slot is refilled from the end
+		_sorted_size = std::min<std::size_t>(_sorted_size, index);
+
+		if constexpr (is_packed()) {
+			const auto last = entity_size() - 1;
+			if (index != last) {
+				move_component(last, index);
+				entity_map().assign(get_members<0>()[index], index);
+
+				// moved components are reported as changed
+				mark_all_changed(index);
+			}
+			pop_component();
+
+		} else {
 			get_members<0>()[index] = invalid_entity_id;
 			free_component_index(index);
-			deregister_entity(id);
 		}
+		deregister_entity(id);
 	}
 
 	decltype(auto) get_component(entity_id id) const {
@@ -96,15 +248,33 @@ public:
 	}
 
 	decltype(auto) get_component(entity_id id) {
-		return get_component_from_index(get_component_index(id));
+		const auto index = get_component_index(id);
+		mark_all_changed(index);
+		return get_component_from_index(index);
 	}
 
 	bool has_component(entity_id id) const {
-		return entity_map().find(id) != entity_map().end();
+		return find_component_index(id) != npos;
 	}
 
 	bool validate_component(entity_id id) const {
-		return has_component(id) && (get_member<0>(id) != invalid_entity_id);
+		return (id != invalid_entity_id) && has_component(id);
+	}
+
+	// component index of id, or npos
+	component_index_type find_component_index(entity_id id) const {
+		// the map is keyed by entity_index(id); a stale generation fails the compare
+		const auto index = entity_map().find(id);
+		return ((index != npos) && (get_members<0>()[index] == id)) ? index : npos;
+	}
+
+	// references to every member except the entity column
+	decltype(auto) get_values_from_index(component_index_type index) const {
+		return make_value_handle(data(), index, std::index_sequence_for<Args...>());
+	}
+
+	decltype(auto) get_values_from_index(component_index_type index) {
+		return make_value_handle(data(), index, std::index_sequence_for<Args...>());
 	}
 
 	template <std::size_t Index>
@@ -114,7 +284,11 @@ public:
 
 	template <std::size_t Index>
 	decltype(auto) get_member(entity_id id) {
-		return get_members<Index>()[get_component_index(id)];
+		const auto index = get_component_index(id);
+		if constexpr (Index > 0) {
+			mark_changed(Index, index);
+		}
+		return get_members<Index>()[index];
 	}
 
 	void clear() {
@@ -126,9 +300,301 @@ public:
 		);
 		entity_map().clear();
 		_component_index_pool.clear();
+		++_structure_version;
+		_sorted_size = 0;
+
+		for (auto &stamps : _stamps) {
+			stamps.clear();
+		}
+		for (auto &changes : _changes) {
+			changes.clear();
+		}
+
+		utility::for_each_in_tuple(
+			_front,
+			[](auto &members) {
+				members.clear();
+			}
+		);
+	}
+
+public:
+	// bytes held by the columns, the entity map and the bookkeeping
+	std::size_t memory_usage() const {
+		std::size_t bytes = entity_map().memory_usage();
+		bytes += free_size() * sizeof(component_index_type);
+
+		auto add_columns = [&](const data_type &columns) {
+			utility::for_each_in_tuple(
+				columns,
+				[&](const auto &members) {
+					bytes += members.capacity() * sizeof(typename std::decay_t<decltype(members)>::value_type);
+				}
+			);
+		};
+		add_columns(_data);
+		if constexpr (is_buffered()) {
+			add_columns(_front);
+		}
+
+		for (const auto &stamps : _stamps) {
+			bytes += stamps.capacity() * sizeof(tick_type);
+		}
+		for (const auto &changes : _changes) {
+			bytes += changes.capacity() * sizeof(typename change_list::value_type);
+		}
+		return bytes;
+	}
+
+	// bytes held by each member column, entity column first
+	std::array<std::size_t, member_size()> column_memory_usage() const {
+		std::array<std::size_t, member_size()> bytes {};
+		std::size_t member = 0;
+		utility::for_each_in_tuple(
+			_data,
+			[&](const auto &members) {
+				bytes[member++] = members.capacity() * sizeof(typename std::decay_t<decltype(members)>::value_type);
+			}
+		);
+		return bytes;
+	}
+
+	system_statistics statistics() const {
+		system_statistics statistics;
+		statistics.live = live_size();
+		statistics.slots = entity_size();
+		statistics.capacity = capacity();
+		statistics.free_slots = free_size();
+		statistics.load_factor = entity_map().load_factor();
+		statistics.map_bytes = entity_map().memory_usage();
+
+		const auto columns = column_memory_usage();
+		statistics.column_bytes.assign(columns.begin(), columns.end());
+		statistics.bytes = memory_usage();
+		return statistics;
+	}
+
+public:
+	// compaction; moves components without changing what the system holds
+	// component indices change the same way as after a packed removal, so
+	// indices taken before the call are stale, moved slots are reported as
+	// changed and a buffered system needs publish() before its front
+	// matches again
+	// every call resumes where the previous one ran out of time and returns
+	// true once the work is done; the work is cut into short steps (a batch
+	// of keys or merged entries, a swap, a hole), so a call does O(1) before
+	// it first looks at the deadline and overruns it by at most one check
+	// interval of steps
+
+	// moves the last components into the holes left by removals, so the
+	// columns are dense again; packed systems never have holes
+	// the lowest hole is filled first, so the tail shrinks as fast as possible
+	bool compact(utility::deadline &limit) {
+		if constexpr (is_packed()) {
+			(void)limit;
+			return true;
+
+		} else {
+			const auto &entities = get_members<0>();
+			while (free_size() != 0) {
+				if (limit.expired()) return false;
+
+				const auto last = static_cast<component_index_type>(entity_size() - 1);
+				if (entities[last] == invalid_entity_id) {
+					// a hole at the end; the pool passes over its index later
+					pop_component();
+					_component_index_pool.shrink(static_cast<component_index_type>(entity_size()), 1);
+					continue;
+				}
+
+				// the lowest hole; the last slot is live, so it is below it
+				const auto index = _component_index_pool.allocate();
+				move_component(last, index);
+				entity_map().assign(entities[index], index);
+				mark_all_changed(index);
+				pop_component();
+				_component_index_pool.shrink(static_cast<component_index_type>(entity_size()), 0);
+			}
+			return true;
+		}
+	}
+
+	// compact(), then orders the components by key(id, members...) so that
+	// walks visit them in that order; equal keys keep their current order
+	// the order is remembered until a component is added or removed, call
+	// reset_compaction() when the keys themselves change
+	// the slots in order since the last sort are kept: only the ones added
+	// or moved behind them are sorted, then merged in from where they
+	// belong, so appending in key order costs O(log n) per sort
+	// a sort keeps going when components are added or removed between
+	// calls, and the next one picks up whatever it missed
+	template <class Key>
+	bool compact(utility::deadline &limit, Key &&key) {
+		if (!compact(limit)) return false;
+
+		const auto &self = static_cast<const basic_system &>(*this);
+		using key_type = std::decay_t<decltype(apply_key(key, invalid_entity_id, self.get_values_from_index(0)))>;
+		using order_type = order_state<key_type>;
+
+		while (_sorted_version != _structure_version) {
+			auto *order = std::any_cast<order_type>(&_order);
+			if (order == nullptr) {
+				// a sort by another key knows nothing of this order
+				if (_order.has_value()) {
+					_sorted_size = 0;
+				}
+				order = &_order.emplace<order_type>();
+				order->version = _structure_version;
+				order->begin = std::min(_sorted_size, entity_size());
+				order->entries.reserve(entity_size() - order->begin);
+
+				// from here on, the lowest slot changed since
+				_sorted_size = entity_size();
+			}
+
+			if (!take_keys(limit, key, *order)) return false;
+			if (!sort_keys(limit, *order)) return false;
+			if (!merge_sorted(limit, key, *order)) return false;
+			if (!apply_order(limit, *order)) return false;
+
+			_sorted_version = order->version;
+			_sorted_size = std::min(_sorted_size, order->position);
+			_order.reset();
+		}
+		return true;
+	}
+
+	bool compact(std::chrono::nanoseconds budget = utility::deadline::unlimited()) {
+		utility::deadline limit(budget);
+		return compact(limit);
+	}
+
+	template <class Key>
+	bool compact_by(Key &&key, std::chrono::nanoseconds budget = utility::deadline::unlimited()) {
+		utility::deadline limit(budget);
+		return compact(limit, std::forward<Key>(key));
+	}
+
+	// forgets the last sort and any sort in progress
+	void reset_compaction() {
+		_sorted_version = npos;
+		_sorted_size = 0;
+		_order.reset();
+	}
+
+public:
+	// double buffering; writers use the columns as usual, readers use the
+	// front copy, which only changes in publish()
+	// the entity map is shared, so structural changes must be applied before
+	// publish() (e.g. through a command_queue) for front lookups to hold
+	// an unbuffered system's front is its live data
+	const data_type &front() const {
+		if constexpr (is_buffered()) {
+			return _front;
+
+		} else {
+			return _data;
+		}
+	}
+
+	template <std::size_t Index>
+	decltype(auto) get_front_members() const {
+		return std::get<Index>(front());
+	}
+
+	decltype(auto) front_entities() const {
+		return get_front_members<0>();
+	}
+
+	// component index of id in the front copy, or npos
+	component_index_type find_front_index(entity_id id) const {
+		const auto index = entity_map().find(id);
+		const auto &entities = front_entities();
+		return ((index != npos) && (index < entities.size()) && (entities[index] == id)) ? index : npos;
+	}
+
+	decltype(auto) get_front_values_from_index(component_index_type index) const {
+		return make_value_handle(front(), index, std::index_sequence_for<Args...>());
+	}
+
+	// publishes the current columns to readers; call at a sync point
+	// this copies every column into the front, O(entity_size()) per call, so
+	// it suits systems that readers need every frame; capacity is reused
+	void publish() {
+		if constexpr (is_buffered()) {
+			_front = _data;
+		}
+	}
+
+public:
+	// change tracking; only tracked storage records anything
+	// get_member(), get_component() and add / emplace stamp the slot with the
+	// current tick, writes through get_members() or views must call mark_changed()
+	tick_type tick() const { return _tick; }
+
+	void set_tick(tick_type tick) { _tick = tick; }
+
+	tick_type advance_tick() { return ++_tick; }
+
+	template <std::size_t Index>
+	void mark_changed(entity_id id) {
+		static_assert(Index > 0, "the entity column is not tracked");
+
+		const auto index = find_component_index(id);
+		if (index != npos) {
+			mark_changed(Index, index);
+		}
+	}
+
+	// tick of the last change to member Index of id, 0 when never changed
+	template <std::size_t Index>
+	tick_type changed_tick(entity_id id) const {
+		static_assert(Index > 0, "the entity column is not tracked");
+
+		const auto index = find_component_index(id);
+		const auto &stamps = _stamps[Index - 1];
+		return ((index != npos) && (index < stamps.size())) ? stamps[index] : 0;
+	}
+
+	// fn(entity_id, member) for each component whose member Index changed
+	// after tick since; costs O(changes), not O(entity_size())
+	template <std::size_t Index, class F>
+	void each_changed(tick_type since, F &&fn) {
+		static_assert(Index > 0, "the entity column is not tracked");
+		static_assert(is_tracked(), "each_changed needs a tracked storage policy");
+
+		const auto &stamps = _stamps[Index - 1];
+		const auto &changes = _changes[Index - 1];
+		const auto &entities = get_members<0>();
+		auto &members = get_members<Index>();
+
+		auto first = std::upper_bound(
+			changes.begin(),
+			changes.end(),
+			since,
+			[](tick_type tick, const typename change_list::value_type &change) {
+				return tick < change.first;
+			}
+		);
+		for (; first != changes.end(); ++first) {
+			const auto index = first->second;
+
+			// a later stamp of the same slot has its own entry
+			if ((index >= entities.size()) || (stamps[index] != first->first)) continue;
+
+			const auto id = entities[index];
+			if (id == invalid_entity_id) continue;
+
+			fn(id, members[index]);
+		}
 	}
 
 protected:
+	template <typename T>
+	static constexpr std::size_t stride_of() {
+		return cache_line_size / std::gcd(cache_line_size, sizeof(T));
+	}
+
 	template <std::size_t Index, typename Tuple>
 	static decltype(auto) get_element(Tuple &tuple, component_index_type index) {
 		auto &container = std::get<Index>(tuple);
@@ -159,6 +625,13 @@ protected:
 		return std::tie(get_element<Indices>(tuple, index)...);
 	}
 
+	template <typename T, std::size_t... Indices>
+	static decltype(auto) make_value_handle(T &tuple, component_index_type index, std::index_sequence<Indices...>) {
+		// unused when there are no members
+		(void)index;
+		return std::tie(std::get<Indices + 1>(tuple)[index]...);
+	}
+
 protected:
 	decltype(auto) get_component_from_index(component_index_type index) const {
 		return make_component_handle(data(), index, std::index_sequence_for<entity_id, Args...>());
@@ -169,34 +642,486 @@ protected:
 	}
 
 	bool register_entity(entity_id id, component_index_type index) {
-		return entity_map().emplace(id, index).second;
+		if (!entity_map().insert(id, index)) return false;
+
+		++_structure_version;
+		_sorted_size = std::min<std::size_t>(_sorted_size, index);
+		return true;
+	}
+
+	// removes the component an older generation of id's index left behind;
+	// a map keyed by entity_index(id) would otherwise refuse to insert id
+	void remove_stale_component(entity_id id) {
+		const auto index = entity_map().find(id);
+		if ((index != npos) && (get_members<0>()[index] != id)) {
+			remove_component(get_members<0>()[index]);
+		}
 	}
 
 	bool deregister_entity(entity_id id) {
-		return (entity_map().erase(id) > 0);
+		if (!entity_map().erase(id)) return false;
+
+		++_structure_version;
+		return true;
 	}
 
 	component_index_type get_component_index(entity_id id) const {
-		return entity_map().at(id);
+		const auto index = find_component_index(id);
+		if (index == npos) {
+			throw std::out_of_range("entity_component_system::system::get_component_index");
+		}
+		return index;
 	}
 
 	const entity_map_type &entity_map() const { return _entity_map; }
 	entity_map_type &entity_map() { return _entity_map; }
 
 	component_index_type allocate_component_index() {
-		return _component_index_pool.allocate();
+		if constexpr (is_packed()) {
+			return entity_size();
+
+		} else {
+			return _component_index_pool.allocate();
+		}
 	}
 
 	void free_component_index(component_index_type index) {
-		_component_index_pool.free(index);
+		if constexpr (!is_packed()) {
+			if (index < entity_size()) {
+				_component_index_pool.free(index);
+
+			} else {
+				// a new index that never reached the columns
+				_component_index_pool.shrink(static_cast<component_index_type>(entity_size()), 0);
+			}
+		}
+	}
+
+	template <class Ids, class... Iterators>
+	void emplace_each(const Ids &ids, Iterators... values) {
+		for (auto id : ids) {
+			add_component(id, component(id, *values...));
+
+			using expander = int[];
+			(void)expander {
+				0, ((void)++values, 0)...
+			};
+		}
+	}
+
+	template <std::size_t... Indices, class... Columns>
+	void append_columns(std::index_sequence<Indices...>, size_t count, const std::vector<size_t> &rows, bool all, const Columns &... columns) {
+		(void)count;
+		(void)all;
+
+		using expander = int[];
+		(void)expander {
+			0, (append_column(get_members<Indices + 1>(), columns, count, rows, all), 0)...
+		};
+	}
+
+	template <class Members, class Column>
+	static void append_column(Members &members, const Column &column, size_t count, const std::vector<size_t> &rows, bool all) {
+		auto first = std::begin(column);
+		if (all) {
+			members.insert(members.end(), first, std::next(first, count));
+
+		} else {
+			for (auto row : rows) {
+				members.push_back(*std::next(first, row));
+			}
+		}
+	}
+
+	void mark_changed(std::size_t member, component_index_type index) {
+		if constexpr (is_tracked()) {
+			auto &stamps = _stamps[member - 1];
+			if (index >= stamps.size()) {
+				stamps.resize(index + 1, 0);
+			}
+			if (stamps[index] == _tick) return;
+
+			stamps[index] = _tick;
+
+			auto &changes = _changes[member - 1];
+			changes.emplace_back(_tick, index);
+
+			// drop superseded entries once they outnumber the slots
+			if (changes.size() > std::max<std::size_t>(stamps.size(), 64) * 2) {
+				changes.erase(
+					std::remove_if(
+						changes.begin(),
+						changes.end(),
+						[&](const typename change_list::value_type &change) {
+							return (change.second >= stamps.size()) || (stamps[change.second] != change.first);
+						}
+					),
+					changes.end()
+				);
+			}
+
+		} else {
+			(void)member;
+			(void)index;
+		}
+	}
+
+	void mark_all_changed(component_index_type index) {
+		if constexpr (is_tracked()) {
+			for (std::size_t member = 1; member <= sizeof...(Args); ++member) {
+				mark_changed(member, index);
+			}
+
+		} else {
+			(void)index;
+		}
+	}
+
+	void move_component(component_index_type from, component_index_type to) {
+		utility::for_each_in_tuple(
+			data(),
+			[&](auto &members) {
+				members[to] = std::move(members[from]);
+			}
+		);
+	}
+
+	void pop_component() {
+		utility::for_each_in_tuple(
+			data(),
+			[](auto &members) {
+				members.pop_back();
+			}
+		);
+	}
+
+	void swap_components(component_index_type a, component_index_type b) {
+		utility::for_each_in_tuple(
+			data(),
+			[&](auto &members) {
+				using std::swap;
+				swap(members[a], members[b]);
+			}
+		);
+
+		const auto &entities = get_members<0>();
+		entity_map().assign(entities[a], a);
+		entity_map().assign(entities[b], b);
+
+		// swapped components are reported as changed
+		mark_all_changed(a);
+		mark_all_changed(b);
+	}
+
+	template <class Key, class Values>
+	static auto apply_key(Key &key, entity_id id, const Values &values) {
+		return std::apply(
+			[&](const auto &... members) {
+				return key(id, members...);
+			},
+			values
+		);
+	}
+
+	enum class order_phase {
+		keys,
+		runs,
+		merge,
+		head,
+		apply,
+	};
+
+	// a sort in progress: the keys of the slots from begin on are taken and
+	// sorted, the slots before begin are in order already; the keys of the
+	// ones among them that belong after the first sorted key are merged in,
+	// then the result is applied slot by slot from split on
+	template <class KeyType>
+	struct order_state {
+		std::vector<std::pair<KeyType, entity_id>> entries;
+		std::vector<std::pair<KeyType, entity_id>> merged;
+		std::vector<std::pair<KeyType, entity_id>> head;
+
+		// structure version the sort started at
+		std::size_t version = 0;
+		std::size_t begin = 0;
+		std::size_t split = 0;
+		bool in_order = true;
+
+		order_phase phase = order_phase::keys;
+
+		// merge in progress; the runs being merged are [first, first + width)
+		// and the next width entries, left and right are their next entries
+		std::size_t width = 0;
+		std::size_t first = 0;
+		std::size_t left = 0;
+		std::size_t right = 0;
+
+		// next entry to apply and the slot it goes to
+		std::size_t cursor = 0;
+		std::size_t position = 0;
+	};
+
+	// runs this short are sorted in one step
+	static constexpr std::size_t order_run_size = 32;
+
+	// keys taken or merged per look at the deadline
+	static constexpr std::size_t order_step_size = 256;
+
+	template <class Key>
+	auto slot_key(Key &key, component_index_type index) const {
+		return apply_key(key, get_members<0>()[index], get_values_from_index(index));
+	}
+
+	template <class Key, class Order>
+	bool take_keys(utility::deadline &limit, Key &key, Order &order) {
+		if (order.phase != order_phase::keys) return true;
+
+		auto &entries = order.entries;
+		while ((order.begin + entries.size()) < entity_size()) {
+			if (limit.expired()) return false;
+
+			const auto last = std::min(order.begin + entries.size() + order_step_size, entity_size());
+			for (auto index = order.begin + entries.size(); index < last; ++index) {
+				entries.emplace_back(slot_key(key, static_cast<component_index_type>(index)), get_members<0>()[index]);
+				if ((entries.size() > 1) && (entries.back().first < entries[entries.size() - 2].first)) {
+					order.in_order = false;
+				}
+			}
+		}
+
+		order.phase = order.in_order ? order_phase::head : order_phase::runs;
+		return true;
+	}
+
+	// moves up to order_step_size entries of the sorted ranges [left,
+	// left_end) of lhs and [right, right_end) of rhs to out, in order; the
+	// left range wins ties
+	template <class Entries>
+	static void merge_entries(Entries &lhs, std::size_t &left, std::size_t left_end, Entries &rhs, std::size_t &right, std::size_t right_end, Entries &out) {
+		auto l = left;
+		auto r = right;
+		for (auto count = order_step_size; count > 0; --count) {
+			if (l == left_end) {
+				const auto rest = std::min(count, right_end - r);
+				std::move(rhs.begin() + r, rhs.begin() + r + rest, std::back_inserter(out));
+				r += rest;
+				break;
+			}
+			if (r == right_end) {
+				const auto rest = std::min(count, left_end - l);
+				std::move(lhs.begin() + l, lhs.begin() + l + rest, std::back_inserter(out));
+				l += rest;
+				break;
+			}
+
+			if (rhs[r].first < lhs[l].first) {
+				out.push_back(std::move(rhs[r++]));
+
+			} else {
+				out.push_back(std::move(lhs[l++]));
+			}
+		}
+		left = l;
+		right = r;
+	}
+
+	// bottom-up stable merge sort of the entries
+	template <class Order>
+	static bool sort_keys(utility::deadline &limit, Order &order) {
+		auto &entries = order.entries;
+		auto &merged = order.merged;
+		const auto size = entries.size();
+
+		// insertion sort of the short runs
+		while (order.phase == order_phase::runs) {
+			if (order.first >= size) {
+				merged.reserve(size);
+				order.phase = (order_run_size < size) ? order_phase::merge : order_phase::head;
+				order.width = order_run_size;
+				order.first = 0;
+				order.left = 0;
+				order.right = std::min(order.width, size);
+				break;
+			}
+			if (limit.expired()) return false;
+
+			const auto last = std::min(order.first + order_run_size, size);
+			for (auto i = order.first + 1; i < last; ++i) {
+				auto entry = std::move(entries[i]);
+				auto j = i;
+				for (; (j > order.first) && (entry.first < entries[j - 1].first); --j) {
+					entries[j] = std::move(entries[j - 1]);
+				}
+				entries[j] = std::move(entry);
+			}
+			order.first = last;
+		}
+
+		while (order.phase == order_phase::merge) {
+			const auto middle = std::min(order.first + order.width, size);
+			const auto last = std::min(order.first + 2 * order.width, size);
+			if (merged.size() == last) {
+				order.first = last;
+				if (order.first >= size) {
+					entries.swap(merged);
+					merged.clear();
+					order.width *= 2;
+					order.first = 0;
+					if (order.width >= size) {
+						order.phase = order_phase::head;
+					}
+				}
+				order.left = order.first;
+				order.right = std::min(order.first + order.width, size);
+				continue;
+			}
+			if (limit.expired()) return false;
+
+			merge_entries(entries, order.left, middle, entries, order.right, last, merged);
+		}
+		return true;
+	}
+
+	// merges the sorted entries with the slots before begin that belong
+	// after the first of them
+	template <class Key, class Order>
+	bool merge_sorted(utility::deadline &limit, Key &key, Order &order) {
+		if (order.phase != order_phase::head) return true;
+
+		auto &entries = order.entries;
+		auto &merged = order.merged;
+		auto &head = order.head;
+
+		const auto begin = std::min(order.begin, entity_size());
+		if (head.empty() && merged.empty()) {
+			// binary search, the slots before begin are in order
+			order.split = begin;
+			if (!entries.empty()) {
+				std::size_t low = 0;
+				while (low < order.split) {
+					const auto middle = low + (order.split - low) / 2;
+					if (entries.front().first < slot_key(key, static_cast<component_index_type>(middle))) {
+						order.split = middle;
+
+					} else {
+						low = middle + 1;
+					}
+				}
+			}
+			head.reserve(begin - order.split);
+			merged.reserve(begin - order.split + entries.size());
+			order.left = 0;
+			order.right = 0;
+		}
+
+		while ((order.split + head.size()) < begin) {
+			if (limit.expired()) return false;
+
+			const auto last = std::min(order.split + head.size() + order_step_size, begin);
+			for (auto index = order.split + head.size(); index < last; ++index) {
+				head.emplace_back(slot_key(key, static_cast<component_index_type>(index)), get_members<0>()[index]);
+			}
+		}
+
+		if (!head.empty()) {
+			// the slots come first on ties
+			const auto size = head.size() + entries.size();
+			while (merged.size() < size) {
+				if (limit.expired()) return false;
+
+				merge_entries(head, order.left, head.size(), entries, order.right, entries.size(), merged);
+			}
+			entries.swap(merged);
+		}
+
+		head = {};
+		merged = {};
+		order.phase = order_phase::apply;
+		order.position = order.split;
+		return true;
+	}
+
+	template <class Order>
+	bool apply_order(utility::deadline &limit, Order &order) {
+		const auto &entries = order.entries;
+
+		// already in place and nothing moved since
+		if (order.in_order && (order.split == order.begin) && (order.version == _structure_version)) {
+			order.position += entries.size();
+			return true;
+		}
+
+		while (order.cursor < entries.size()) {
+			if (limit.expired()) return false;
+
+			const auto from = find_component_index(entries[order.cursor++].second);
+
+			// removed since, or moved in among the slots already placed
+			if ((from == npos) || (from < order.position)) continue;
+
+			const auto to = static_cast<component_index_type>(order.position++);
+			if (from != to) {
+				swap_components(from, to);
+			}
+		}
+		return true;
 	}
 
 private:
 	entity_map_type _entity_map;
 	component_index_pool _component_index_pool;
 	data_type _data;
+
+	data_type _front;
+
+	tick_type _tick = 1;
+	std::array<tick_list, sizeof...(Args)> _stamps;
+	std::array<change_list, sizeof...(Args)> _changes;
+
+	// bumped by every insertion, removal and clear
+	std::size_t _structure_version = 0;
+	std::size_t _sorted_version = npos;
+
+	// slots in order since the last sort; while one runs, the lowest slot
+	// changed since it started
+	std::size_t _sorted_size = 0;
+
+	// order_state of the sort in progress, if any
+	std::any _order;
 };
 
+// compaction key that walks components in entity index order, the order
+// in which a join over several systems finds them
+struct by_entity_index {
+	template <class... Values>
+	entity_id operator()(entity_id id, const Values &...) const {
+		return entity_index(id);
+	}
+};
+
+template <typename... Args>
+using system = basic_system<default_storage, Args...>;
+
+template <typename... Args>
+using sparse_system = basic_system<sparse_storage, Args...>;
+
+template <typename... Args>
+using hashed_system = basic_system<hashed_storage, Args...>;
+
+template <typename... Args>
+using packed_system = basic_system<packed_storage, Args...>;
+
+template <typename... Args>
+using tracked_system = basic_system<tracked_storage, Args...>;
+
+template <typename... Args>
+using buffered_system = basic_system<buffered_storage, Args...>;
+
+// components never move when the system grows; walk get_members<I>().page(p)
+// for contiguous runs
+template <typename... Args>
+using paged_system = basic_system<paged_storage, Args...>;
+
 } // namespace entity_component_system
 
 #endif // ENTITY_COMPONENT_SYSTEM_SYSTEM_HPP_
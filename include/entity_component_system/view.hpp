@@ -0,0 +1,184 @@
+
+#ifndef ENTITY_COMPONENT_SYSTEM_VIEW_HPP_
+#define ENTITY_COMPONENT_SYSTEM_VIEW_HPP_
+
+#include <cstddef>
+#include <array>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+
+#include "entity.hpp"
+
+namespace entity_component_system {
+
+// which columns a view reads
+struct back_buffer {
+	template <class System>
+	static decltype(auto) entities(System &system) { return system.entities(); }
+
+	template <class System>
+	static std::size_t find(System &system, entity_id id) { return system.find_component_index(id); }
+
+	template <class System>
+	static decltype(auto) values(System &system, std::size_t index) { return system.get_values_from_index(index); }
+};
+
+// the read-only copy published by publish()
+struct front_buffer {
+	template <class System>
+	static decltype(auto) entities(System &system) { return system.front_entities(); }
+
+	template <class System>
+	static std::size_t find(System &system, entity_id id) { return system.find_front_index(id); }
+
+	template <class System>
+	static decltype(auto) values(System &system, std::size_t index) { return system.get_front_values_from_index(index); }
+};
+
+// join over several systems of a world
+// the system holding the fewest components drives the loop, the others are
+// probed by entity_id
+template <class Buffer, class World, std::size_t... Is>
+class basic_view {
+public:
+	using world_type = World;
+
+	static_assert(sizeof...(Is) > 0, "view needs at least one system");
+
+	static constexpr std::size_t system_size() { return sizeof...(Is); }
+
+public:
+	explicit basic_view(world_type &world) : _world(world) {}
+
+	// live_size() of the driving system, an upper bound on the entities
+	// visited
+	std::size_t size_hint() const {
+		const auto sizes = system_sizes();
+		return *std::min_element(sizes.begin(), sizes.end());
+	}
+
+	// fn(entity_id, members of Is...)
+	template <class F>
+	void each(F &&fn) {
+		each_driven_by(fn, driver(), std::make_index_sequence<sizeof...(Is)>());
+	}
+
+	template <class F>
+	void operator()(F &&fn) {
+		each(std::forward<F>(fn));
+	}
+
+protected:
+	template <std::size_t N>
+	static constexpr std::size_t system_index() {
+		constexpr std::size_t indices[] = { Is... };
+		return indices[N];
+	}
+
+	std::array<std::size_t, sizeof...(Is)> system_sizes() const {
+		// holes in a stable system's columns are not counted
+		return { { _world.template get_system<Is>().live_size()... } };
+	}
+
+	std::size_t driver() const {
+		const auto sizes = system_sizes();
+		return static_cast<std::size_t>(std::min_element(sizes.begin(), sizes.end()) - sizes.begin());
+	}
+
+	template <class F, std::size_t... Ns>
+	void each_driven_by(F &fn, std::size_t driver, std::index_sequence<Ns...>) {
+		using expander = int[];
+		(void)expander {
+			0, ((driver == Ns) ? (each_driven_by<Ns>(fn), 0) : 0)...
+		};
+	}
+
+	template <std::size_t Driver, class F>
+	void each_driven_by(F &fn) {
+		auto &driving = _world.template get_system<system_index<Driver>()>();
+		const auto &entities = Buffer::entities(driving);
+
+		for (std::size_t i = 0; i < entities.size(); ++i) {
+			const auto id = entities[i];
+			if (id == invalid_entity_id) continue;
+
+			std::array<std::size_t, sizeof...(Is)> indices;
+			if (!find_indices<Driver>(id, i, indices, std::make_index_sequence<sizeof...(Is)>())) continue;
+
+			invoke(fn, id, indices, std::make_index_sequence<sizeof...(Is)>());
+		}
+	}
+
+	template <std::size_t Driver, std::size_t... Ns>
+	bool find_indices(entity_id id, std::size_t driver_index, std::array<std::size_t, sizeof...(Is)> &indices, std::index_sequence<Ns...>) const {
+		bool found = true;
+		using expander = int[];
+		(void)expander {
+			0, (found = found && find_index<Driver, Ns>(id, driver_index, indices[Ns]), 0)...
+		};
+		return found;
+	}
+
+	template <std::size_t Driver, std::size_t N>
+	bool find_index(entity_id id, std::size_t driver_index, std::size_t &index) const {
+		if constexpr (N == Driver) {
+			index = driver_index;
+			return true;
+
+		} else {
+			const auto &system = _world.template get_system<system_index<N>()>();
+			index = Buffer::find(system, id);
+			return index != std::decay_t<decltype(system)>::npos;
+		}
+	}
+
+	template <class F, std::size_t... Ns>
+	void invoke(F &fn, entity_id id, const std::array<std::size_t, sizeof...(Is)> &indices, std::index_sequence<Ns...>) {
+		std::apply(
+			fn,
+			std::tuple_cat(
+				std::tuple<entity_id>(id),
+				Buffer::values(_world.template get_system<system_index<Ns>()>(), indices[Ns])...
+			)
+		);
+	}
+
+private:
+	world_type &_world;
+};
+
+template <class World, std::size_t... Is>
+using view = basic_view<back_buffer, World, Is...>;
+
+template <class World, std::size_t... Is>
+using front_view = basic_view<front_buffer, const World, Is...>;
+
+// components of system I whose member Member changed after tick since
+template <class World, std::size_t I, std::size_t Member>
+class changed_view {
+public:
+	using world_type = World;
+
+public:
+	changed_view(world_type &world, tick_type since) : _world(world), _since(since) {}
+
+	// fn(entity_id, member)
+	template <class F>
+	void each(F &&fn) {
+		_world.template get_system<I>().template each_changed<Member>(_since, std::forward<F>(fn));
+	}
+
+	template <class F>
+	void operator()(F &&fn) {
+		each(std::forward<F>(fn));
+	}
+
+private:
+	world_type &_world;
+	tick_type _since;
+};
+
+} // namespace entity_component_system
+
+#endif // ENTITY_COMPONENT_SYSTEM_VIEW_HPP_
@@ -3,16 +3,27 @@
 #define ENTITY_COMPONENT_SYSTEM_WORLD_HPP_
 
 #include <tuple>
-#include <deque>
+#include <type_traits>
+#include <vector>
 #include <functional>
+#include <utility>
+#include <algorithm>
+#include <chrono>
 
-#include "utility/id_pool.hpp"
 #include "utility/for_each.hpp"
+#include "utility/thread_pool.hpp"
+#include "utility/deadline.hpp"
 
 #include "entity.hpp"
+#include "registry.hpp"
+#include "view.hpp"
+#include "statistics.hpp"
+#include "behaviour.hpp"
 
 namespace entity_component_system {
 
+struct snapshot_access;
+
 template <class... Systems>
 class world {
 public:
@@ -24,12 +35,17 @@ public:
 	template <std::size_t I>
 	using component = typename system<I>::component;
 
-	using entity_pool = utility::id_pool<entity_id>;
-	using entity_list_type = std::deque<entity_id>;
+	using registry_type = registry<sizeof...(Systems)>;
+	using entity_pool = typename registry_type::entity_pool;
+	using entity_list_type = typename registry_type::entity_list_type;
+	using signature_type = typename registry_type::signature_type;
+	using invoke_timers_type = invoke_timers<sizeof...(Systems)>;
+
+	friend snapshot_access;
 
 	class entity {
 	public:
-		using world = world;
+		using world = entity_component_system::world<Systems...>;
 
 		template <size_t I>
 		using system = world::system<I>;
@@ -50,6 +66,8 @@ public:
 
 		entity_id id() const { return _id; }
 
+		bool alive() const { return _world.is_alive(_id); }
+
 		template <size_t I = 0>
 		decltype(auto) get_system() const { return _world.get_system<I>(); }
 
@@ -110,10 +128,13 @@ public:
 	template <size_t I = 0>
 	decltype(auto) get_system() const { return std::get<I>(_system_data); }
 
+	// a component added through the system itself is removed with its
+	// entity, but signature() and has_component() only see the ones added
+	// through the world
 	template <size_t I = 0>
 	decltype(auto) get_system() { return std::get<I>(_system_data); }
 
-	const entity_list_type &entities() const { return _entity_list; }
+	const entity_list_type &entities() const { return _registry.entities(); }
 
 	template <size_t I = 0>
 	decltype(auto) system_entities() const {
@@ -122,22 +143,131 @@ public:
 
 	size_t entity_size() const { return entities().size(); }
 
+	bool is_alive(entity_id id) const { return _registry.alive(id); }
+
+	const entity_pool &pool() const { return _registry.pool(); }
+
+	const registry_type &entity_registry() const { return _registry; }
+
+	const signature_type &signature(entity_id id) const { return _registry.signature(id); }
+
+	tick_type tick() const { return _tick; }
+
+	// bytes held by the registry and every system
+	std::size_t memory_usage() const {
+		std::size_t bytes = _registry.memory_usage();
+		utility::for_each_in_tuple(
+			_system_data,
+			[&](const auto &system) {
+				bytes += system.memory_usage();
+			}
+		);
+		return bytes;
+	}
+
+	// occupancy and memory of every system plus the invoke timers; cheap
+	// enough to scrape once per frame
+	world_statistics statistics() const {
+		world_statistics statistics;
+		statistics.tick = _tick;
+		statistics.entities = entity_size();
+		statistics.free_ids = _registry.free_size();
+		statistics.bytes = _registry.memory_usage();
+
+		statistics.systems.reserve(system_size());
+		utility::for_each_in_tuple(
+			_system_data,
+			[&](const auto &system) {
+				statistics.systems.push_back(system.statistics());
+				statistics.systems.back().invokes = _invoke_timers.get(statistics.systems.size() - 1);
+				statistics.bytes += statistics.systems.back().bytes;
+			}
+		);
+		return statistics;
+	}
+
+	// invoke_system() timers; all zero unless ENTITY_COMPONENT_SYSTEM_STATISTICS is defined
+	template <std::size_t Index = 0>
+	invoke_statistics system_invoke_statistics() const {
+		return _invoke_timers.get(Index);
+	}
+
+	void reset_invoke_statistics() {
+		_invoke_timers.reset();
+	}
+
+	// invokes are recorded into recorder until nullptr is set
+	// the recorder must outlive the world or be unset first
+	void set_trace_recorder(trace_recorder *recorder) {
+		_invoke_timers.set_recorder(recorder);
+	}
+
+	// compacts every system and sorts it by entity index, so joins walk the
+	// systems in step; spread over frames with a budget, which is shared by
+	// all systems and resumed on the next call; after the first sort only
+	// the components added or moved since are sorted and merged in
+	// returns true once every system is done; component indices change
+	bool optimize(std::chrono::nanoseconds budget = utility::deadline::unlimited()) {
+		utility::deadline limit(budget);
+		bool done = true;
+		utility::for_each_in_tuple(
+			_system_data,
+			[&](auto &system) {
+				done = system.compact(limit, by_entity_index()) && done;
+			}
+		);
+		return done;
+	}
+
+	// call once per frame; changes made after this carry the new tick
+	tick_type advance_tick() {
+		++_tick;
+		utility::for_each_in_tuple(
+			_system_data,
+			[&](auto &system) {
+				system.set_tick(_tick);
+			}
+		);
+		return _tick;
+	}
+
 public:
 	entity make_entity() {
-		entity_id id = _entity_pool.allocate();
-		entity_list().push_back(id);
-		return entity(*this, id);
+		return entity(*this, _registry.create());
 	}
 
-	void remove_entity(entity_id id) {
-		entity_list().erase(std::remove(entity_list().begin(), entity_list().end(), id), entity_list().end());
+	entity_list_type create_many(size_t count) {
+		entity_list_type ids;
+		_registry.create_many(count, ids);
+		return ids;
+	}
+
+	// room for size entities in the registry and in every system
+	void reserve(size_t size) {
+		_registry.reserve_capacity(size);
 		utility::for_each_in_tuple(
 			_system_data,
 			[&](auto &system) {
-				system.remove_component(id);
+				system.reserve(size);
 			}
 		);
-		_entity_pool.free(id);
+	}
+
+	// an id that is alive but not in entities() until commit_entity()
+	// may grow the registry, so no other thread may read the world meanwhile
+	entity_id reserve_entity() {
+		return _registry.reserve();
+	}
+
+	bool commit_entity(entity_id id) {
+		return _registry.commit(id);
+	}
+
+	void remove_entity(entity_id id) {
+		if (!is_alive(id)) return;
+
+		remove_components(id, signature(id), std::index_sequence_for<Systems...>());
+		_registry.destroy(id);
 	}
 
 	void clear() {
@@ -147,23 +277,58 @@ public:
 				system.clear();
 			}
 		);
-		_entity_pool.clear();
-		entity_list().clear();
+		_registry.clear();
 	}
 
 	template <size_t I = 0>
 	void add_component(entity_id id, component<I> &&initializer) {
-		get_system<I>().add_component(id, initializer);
+		if (!is_alive(id)) return;
+
+		if (get_system<I>().add_component(id, std::move(initializer))) {
+			_registry.set(id, I);
+		}
 	}
 
 	template <size_t I = 0, class... Args>
 	void emplace_component(entity_id id, Args&&... args) {
-		get_system<I>().emplace_component(id, std::forward<Args>(args)...);
+		if (!is_alive(id)) return;
+
+		if (get_system<I>().emplace_component(id, std::forward<Args>(args)...)) {
+			_registry.set(id, I);
+		}
+	}
+
+	// one component per id, filled column by column; like
+	// emplace_component(), dead ids are skipped, one component at a time
+	template <size_t I = 0, class Ids, class... Columns>
+	void emplace_range(const Ids &ids, const Columns &... columns) {
+		const bool alive = std::all_of(
+			std::begin(ids),
+			std::end(ids),
+			[&](entity_id id) {
+				return is_alive(id);
+			}
+		);
+		if (!alive) {
+			emplace_each<I>(ids, std::begin(columns)...);
+			return;
+		}
+
+		get_system<I>().emplace_range(ids, columns...);
+		for (auto id : ids) {
+			_registry.set(id, I);
+		}
 	}
 
 	template <size_t I = 0>
 	void remove_component(entity_id id) {
 		get_system<I>().remove_component(id);
+		_registry.reset(id, I);
+	}
+
+	template <size_t I = 0>
+	bool has_component(entity_id id) const {
+		return _registry.test(id, I);
 	}
 
 	template <size_t I = 0>
@@ -178,29 +343,134 @@ public:
 
 	template <size_t I = 0, std::size_t Member>
 	decltype(auto) get_members() {
-		return get_system<I>().get_members<Member>();
+		return get_system<I>().template get_members<Member>();
+	}
+
+	template <std::size_t... Is>
+	entity_component_system::view<world, Is...> view() {
+		return entity_component_system::view<world, Is...>(*this);
+	}
+
+	template <std::size_t... Is>
+	entity_component_system::view<const world, Is...> view() const {
+		return entity_component_system::view<const world, Is...>(*this);
+	}
+
+	// system I must use a tracked storage policy
+	template <std::size_t I, std::size_t Member>
+	entity_component_system::changed_view<world, I, Member> changed(tick_type since) {
+		return entity_component_system::changed_view<world, I, Member>(*this, since);
+	}
+
+	template <std::size_t... Is, class Function>
+	void each(Function &&f) {
+		view<Is...>().each(std::forward<Function>(f));
+	}
+
+	template <std::size_t... Is, class Function>
+	void each(Function &&f) const {
+		view<Is...>().each(std::forward<Function>(f));
+	}
+
+	// reads the columns published by the last publish(); safe while
+	// other threads write the systems, as long as nothing is added or removed
+	template <std::size_t... Is>
+	entity_component_system::front_view<world, Is...> front_view() const {
+		return entity_component_system::front_view<world, Is...>(*this);
+	}
+
+	template <std::size_t... Is, class Function>
+	void each_front(Function &&f) const {
+		front_view<Is...>().each(std::forward<Function>(f));
+	}
+
+	// publishes every buffered system, copying each of their columns; call
+	// after structural changes were applied
+	void publish() {
+		utility::for_each_in_tuple(
+			_system_data,
+			[](auto &system) {
+				system.publish();
+			}
+		);
 	}
 
 	template <std::size_t Index = 0, class Function>
 	decltype(auto) invoke_system(Function &f) {
+		const auto scope = _invoke_timers.make_scope(Index);
 		return f(*this, get_system<Index>());
 	}
 
 	template <std::size_t Index = 0, class Function>
 	decltype(auto) invoke_system(const Function &f) const {
+		const auto scope = _invoke_timers.make_scope(Index);
 		return f(*this, get_system<Index>());
 	}
 
 	template <std::size_t Index = 0, class Function>
 	decltype(auto) invoke_system(Function &&f) {
+		const auto scope = _invoke_timers.make_scope(Index);
 		return f(*this, get_system<Index>());
 	}
 
 	template <std::size_t Index = 0, class Function>
 	decltype(auto) invoke_system(const Function &&f) const {
+		const auto scope = _invoke_timers.make_scope(Index);
 		return f(*this, get_system<Index>());
 	}
 
+	// calls update(args...) of every value in system I, a system of one
+	// behaviour type such as system<boid>; see behaviour.hpp
+	// entities whose update returns false are removed; the columns are walked
+	// from the back, so a packed system's swap and pop skips nothing
+	// updates must not add or remove other entities, use a command_queue
+	// returns the number of components left
+	template <std::size_t Index, class... Args>
+	std::size_t update_behaviours(Args&&... args) {
+		const auto scope = _invoke_timers.make_scope(Index);
+
+		auto &system = get_system<Index>();
+		static_assert(std::decay_t<decltype(system)>::member_size() == 2, "update_behaviours needs a system of one behaviour type");
+
+		const auto &entities = system.entities();
+		auto &values = system.template get_members<1>();
+		for (std::size_t i = entities.size(); i-- > 0;) {
+			const auto id = entities[i];
+			if (id == invalid_entity_id) continue;
+
+			if (!detail::invoke_behaviour(values[i], id, args...)) {
+				remove_entity(id);
+			}
+		}
+		return system.live_size();
+	}
+
+	// f(world, system, begin, end) for each chunk of the system's columns
+	// grain is rounded up to whole cache lines, and the columns start on one,
+	// so no two chunks write to the same line; 0 picks a grain from the pool size
+	template <std::size_t Index = 0, class Function>
+	void parallel_invoke_system(Function &&f, std::size_t grain = 0, utility::thread_pool &pool = utility::thread_pool::shared()) {
+		const auto scope = _invoke_timers.make_scope(Index);
+
+		auto &system = get_system<Index>();
+		const auto size = system.entity_size();
+		const auto stride = system.cache_line_stride();
+
+		if (grain == 0) {
+			grain = size / ((pool.size() + 1) * 4);
+		}
+		grain = std::max<std::size_t>((grain + stride - 1) / stride, 1) * stride;
+
+		pool.parallel_for(
+			0,
+			size,
+			grain,
+			[&](std::size_t begin, std::size_t end) {
+				f(*this, system, begin, end);
+			}
+		);
+	}
+
 	template <class F>
 	void for_each_system(F &&f) {
 		utility::for_each_in_tuple(_system_data, f);
@@ -222,12 +492,33 @@ public:
 	}
 
 protected:
-	entity_list_type &entity_list() { return _entity_list; }
+	template <std::size_t... Is>
+	void remove_components(entity_id id, const signature_type &signature, std::index_sequence<Is...>) {
+		// the signature covers components added through the world; one added
+		// through get_system() is found by the system's own lookup
+		using expander = int[];
+		(void)expander {
+			0, ((signature.test(Is) || get_system<Is>().has_component(id)) ? (get_system<Is>().remove_component(id), 0) : 0)...
+		};
+	}
+
+	template <size_t I, class Ids, class... Iterators>
+	void emplace_each(const Ids &ids, Iterators... values) {
+		for (auto id : ids) {
+			add_component<I>(id, component<I>(id, *values...));
+
+			using expander = int[];
+			(void)expander {
+				0, ((void)++values, 0)...
+			};
+		}
+	}
 
 private:
 	system_data _system_data;
-	entity_pool _entity_pool;
-	entity_list_type _entity_list;
+	registry_type _registry;
+	tick_type _tick = 1;
+	mutable invoke_timers_type _invoke_timers;
 };
 
 } // namespace entity_component_system
@@ -0,0 +1,85 @@
+
+#ifndef FLAPPY_BOID_BATCH_HPP_
+#define FLAPPY_BOID_BATCH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <limits>
+
+#include "utility/thread_pool.hpp"
+
+#include "game.hpp"
+
+namespace flappy_boid {
+
+// independent games stepped in parallel, one game per task
+// the controller is shared by every thread, so it must be safe to call
+// concurrently for different games
+class batch {
+public:
+	using game_list_type = std::vector<game>;
+
+public:
+	explicit batch(utility::thread_pool &pool = utility::thread_pool::shared()) : _pool(pool) {}
+
+	// count games with boids boids each; game i is seeded with seed + i
+	void setup(std::size_t count, std::size_t boids, const config &settings = config(), std::uint32_t seed = 0) {
+		_games.clear();
+		_games.reserve(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			_games.emplace_back(settings, static_cast<std::uint32_t>(seed + i));
+			for (std::size_t b = 0; b < boids; ++b) {
+				_games.back().add_boid();
+			}
+		}
+	}
+
+	game_list_type &games() { return _games; }
+	const game_list_type &games() const { return _games; }
+
+	std::size_t size() const { return _games.size(); }
+
+	bool finished() const {
+		for (const auto &g : _games) {
+			if (!g.finished()) return false;
+		}
+		return true;
+	}
+
+	// every unfinished game takes up to steps steps; returns the steps taken
+	template <class Controller>
+	std::uint64_t step(Controller &&controller, std::uint64_t steps = 1) {
+		std::vector<std::uint64_t> taken(_games.size(), 0);
+		_pool.parallel_for(
+			0,
+			_games.size(),
+			1,
+			[&](std::size_t begin, std::size_t end) {
+				for (auto i = begin; i < end; ++i) {
+					taken[i] = _games[i].run(controller, steps);
+				}
+			}
+		);
+
+		std::uint64_t total = 0;
+		for (auto count : taken) {
+			total += count;
+		}
+		return total;
+	}
+
+	// runs every game to the end, or to max_steps
+	template <class Controller>
+	std::uint64_t run(Controller &&controller, std::uint64_t max_steps = std::numeric_limits<std::uint64_t>::max()) {
+		return step(controller, max_steps);
+	}
+
+private:
+	utility::thread_pool &_pool;
+	game_list_type _games;
+};
+
+} // namespace flappy_boid
+
+#endif // FLAPPY_BOID_BATCH_HPP_
@@ -0,0 +1,9 @@
+
+#ifndef FLAPPY_BOID_HPP_
+#define FLAPPY_BOID_HPP_
+
+#include "geometry.hpp"
+#include "game.hpp"
+#include "batch.hpp"
+
+#endif // FLAPPY_BOID_HPP_
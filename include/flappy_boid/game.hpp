@@ -0,0 +1,327 @@
+
+#ifndef FLAPPY_BOID_GAME_HPP_
+#define FLAPPY_BOID_GAME_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <random>
+#include <limits>
+#include <utility>
+
+#include "entity_component_system/entity_component_system.hpp"
+
+#include "geometry.hpp"
+
+namespace flappy_boid {
+
+namespace ecs = entity_component_system;
+
+// every tunable of a game; the defaults reproduce the original Siv3D
+// game at 60 fps in a 640x480 window
+struct config {
+	double width = 640;
+	double height = 480;
+
+	// seconds per step
+	double timestep = 1.0 / 60.0;
+
+	double gravity = 9.80665;
+
+	// falling adds gravity * fall_scale per second, a jump sets the
+	// velocity to -gravity * jump_scale
+	double fall_scale = 100;
+	double jump_scale = 30;
+
+	double boid_radius = 15;
+
+	// horizontal position of every boid, relative to width
+	double boid_x = 0.2;
+
+	// pixels per second (4 per frame at 60 fps)
+	double pipe_speed = 240;
+	double pipe_width = 50;
+	double pipe_gap = 100;
+
+	// pipes appear this far right of the screen
+	double pipe_margin = 50;
+
+	// the gap centre is up to this far from the middle of the screen
+	int pipe_offset = 100;
+
+	// seconds between two pipes
+	double pipe_span = 1.0;
+};
+
+struct boid {
+	double y;
+	double velocity_y;
+
+	// pipes passed and steps survived
+	int score;
+	std::uint32_t steps;
+
+	bool alive;
+};
+
+struct drainpipe {
+	double x;
+	double gap_y;
+
+	// the centre was passed by the boids
+	bool cleared;
+
+	rect upper(const config &settings) const {
+		return { x, gap_y - settings.pipe_gap / 2 - settings.height, settings.pipe_width, settings.height };
+	}
+
+	rect lower(const config &settings) const {
+		return { x, gap_y + settings.pipe_gap / 2, settings.pipe_width, settings.height };
+	}
+};
+
+// what a controller usually needs to know about a boid
+struct observation {
+	// from the boid to the centre of the next gap
+	double dx;
+	double dy;
+
+	double velocity_y;
+};
+
+// one game, without any platform dependency
+// step() advances a fixed timestep; input comes from a controller called
+// as bool(const game &, ecs::entity_id, const boid &) per living boid, true
+// meaning jump
+class game {
+public:
+	using boid_system = ecs::packed_system<boid>;
+	using drainpipe_system = ecs::packed_system<drainpipe>;
+	using world_type = ecs::world<boid_system, drainpipe_system>;
+	using grid_type = ecs::spatial_grid<double>;
+
+	enum system_index : std::size_t {
+		boids,
+		drainpipes,
+	};
+
+	enum member_index : std::size_t {
+		entity,
+		value,
+	};
+
+public:
+	explicit game(const config &settings = config(), std::uint32_t seed = std::mt19937::default_seed)
+		: _config(settings), _engine(seed), _grid(64.0) {}
+
+	const config &settings() const { return _config; }
+
+	const world_type &world() const { return _world; }
+
+	const grid_type &grid() const { return _grid; }
+
+	std::uint64_t steps() const { return _steps; }
+
+	double time() const { return static_cast<double>(_steps) * _config.timestep; }
+
+	// pipes passed while at least one boid was alive
+	int score() const { return _score; }
+
+	std::size_t alive_size() const { return _alive; }
+
+	bool finished() const { return (_alive == 0); }
+
+	double boid_x() const { return _config.width * _config.boid_x; }
+
+	circle boid_circle(const boid &b) const {
+		return { boid_x(), b.y, _config.boid_radius };
+	}
+
+	// back to an empty stage; the random sequence continues
+	void reset() {
+		_world.clear();
+		_grid.clear();
+		_steps = 0;
+		_score = 0;
+		_alive = 0;
+		_span = 0;
+	}
+
+	ecs::entity_id add_boid() {
+		auto entity = _world.make_entity();
+		entity.emplace_component<boids>(boid { _config.height / 2, 0, 0, 0, true });
+		++_alive;
+		return entity.id();
+	}
+
+	// fn(id, boid) for every boid, dead ones included
+	template <class F>
+	void each_boid(F &&fn) const {
+		const auto &system = _world.get_system<boids>();
+		const auto &entities = system.get_members<entity>();
+		const auto &values = system.get_members<value>();
+		for (std::size_t i = 0; i < entities.size(); ++i) {
+			fn(entities[i], values[i]);
+		}
+	}
+
+	template <class F>
+	void each_drainpipe(F &&fn) const {
+		const auto &system = _world.get_system<drainpipes>();
+		const auto &entities = system.get_members<entity>();
+		const auto &values = system.get_members<value>();
+		for (std::size_t i = 0; i < entities.size(); ++i) {
+			fn(entities[i], values[i]);
+		}
+	}
+
+	observation observe(const boid &b) const {
+		observation result { _config.width, 0, b.velocity_y };
+
+		// the nearest pipe whose right edge is still ahead of the boid
+		const auto x = boid_x();
+		each_drainpipe([&](ecs::entity_id, const drainpipe &pipe) {
+			const auto dx = pipe.x + _config.pipe_width - x;
+			if ((dx >= 0) && (dx < result.dx)) {
+				result.dx = dx;
+				result.dy = pipe.gap_y - b.y;
+			}
+		});
+		return result;
+	}
+
+	template <class Controller>
+	void step(Controller &&controller) {
+		const auto dt = _config.timestep;
+
+		update_stage(dt);
+		const auto passed = update_drainpipes(dt);
+		update_boids(dt, passed, controller);
+
+		if ((passed > 0) && (_alive > 0)) {
+			_score += passed;
+		}
+		++_steps;
+	}
+
+	// steps until every boid is dead or max_steps were taken
+	template <class Controller>
+	std::uint64_t run(Controller &&controller, std::uint64_t max_steps = std::numeric_limits<std::uint64_t>::max()) {
+		std::uint64_t count = 0;
+		while (!finished() && (count < max_steps)) {
+			step(controller);
+			++count;
+		}
+		return count;
+	}
+
+protected:
+	void update_stage(double dt) {
+		_span -= dt;
+		if (_span < 0) {
+			add_drainpipe();
+			_span = _config.pipe_span;
+		}
+	}
+
+	void add_drainpipe() {
+		std::uniform_int_distribution<int> offset(-_config.pipe_offset, _config.pipe_offset);
+
+		auto entity = _world.make_entity();
+		const drainpipe pipe { _config.width + _config.pipe_margin, _config.height / 2 - offset(_engine), false };
+		entity.emplace_component<drainpipes>(drainpipe(pipe));
+		_grid.update(entity.id(), bounds_of(pipe));
+	}
+
+	// both halves of a pipe as one box; boids are tested against the halves
+	// only when the box is hit
+	grid_type::bounds_type bounds_of(const drainpipe &pipe) const {
+		return { pipe.x, -_config.height, pipe.x + _config.pipe_width, _config.height * 2 };
+	}
+
+	// returns the number of pipes whose centre passed the boids
+	int update_drainpipes(double dt) {
+		auto &system = _world.get_system<drainpipes>();
+		const auto &entities = system.get_members<entity>();
+		auto &values = system.get_members<value>();
+
+		const auto x = boid_x();
+		int passed = 0;
+
+		// from the back: a removal moves the last pipe into the hole
+		for (std::size_t i = entities.size(); i-- > 0;) {
+			const auto id = entities[i];
+			auto &pipe = values[i];
+
+			pipe.x -= _config.pipe_speed * dt;
+			if (pipe.x <= -_config.pipe_width) {
+				_grid.erase(id);
+				_world.remove_entity(id);
+				continue;
+			}
+			_grid.update(id, bounds_of(pipe));
+
+			if (!pipe.cleared && (x > pipe.x + _config.pipe_width / 2)) {
+				pipe.cleared = true;
+				++passed;
+			}
+		}
+		return passed;
+	}
+
+	bool collides(const boid &b) const {
+		const auto c = boid_circle(b);
+		bool hit = false;
+		_grid.query(
+			grid_type::bounds_type::centered(c.x, c.y, c.r, c.r),
+			[&](ecs::entity_id id, const grid_type::bounds_type &) {
+				const auto &pipe = _world.get_system<drainpipes>().get_member<value>(id);
+				hit = hit || pipe.upper(_config).intersects(c) || pipe.lower(_config).intersects(c);
+			}
+		);
+		return hit;
+	}
+
+	template <class Controller>
+	void update_boids(double dt, int passed, Controller &controller) {
+		auto &system = _world.get_system<boids>();
+		const auto &entities = system.get_members<entity>();
+		auto &values = system.get_members<value>();
+
+		for (std::size_t i = 0; i < entities.size(); ++i) {
+			auto &b = values[i];
+			if (!b.alive) continue;
+
+			b.y += b.velocity_y * dt;
+			if ((b.y <= -_config.boid_radius) || (b.y > _config.height + _config.boid_radius) || collides(b)) {
+				b.alive = false;
+				--_alive;
+				continue;
+			}
+
+			// falling
+			b.velocity_y += _config.gravity * dt * _config.fall_scale;
+			b.score += passed;
+			++b.steps;
+
+			// jump
+			if (controller(static_cast<const game &>(*this), entities[i], static_cast<const boid &>(b))) {
+				b.velocity_y = -_config.gravity * _config.jump_scale;
+			}
+		}
+	}
+
+private:
+	config _config;
+	std::mt19937 _engine;
+	world_type _world;
+	grid_type _grid;
+	std::uint64_t _steps = 0;
+	int _score = 0;
+	std::size_t _alive = 0;
+	double _span = 0;
+};
+
+} // namespace flappy_boid
+
+#endif // FLAPPY_BOID_GAME_HPP_
@@ -0,0 +1,33 @@
+
+#ifndef FLAPPY_BOID_GEOMETRY_HPP_
+#define FLAPPY_BOID_GEOMETRY_HPP_
+
+#include <algorithm>
+
+namespace flappy_boid {
+
+struct circle {
+	double x;
+	double y;
+	double r;
+};
+
+struct rect {
+	double x;
+	double y;
+	double w;
+	double h;
+
+	// touching counts, like Siv3D's Rect::intersects(Circle)
+	bool intersects(const circle &c) const {
+		const auto nearest_x = std::min(std::max(c.x, x), x + w);
+		const auto nearest_y = std::min(std::max(c.y, y), y + h);
+		const auto dx = c.x - nearest_x;
+		const auto dy = c.y - nearest_y;
+		return (dx * dx + dy * dy) <= (c.r * c.r);
+	}
+};
+
+} // namespace flappy_boid
+
+#endif // FLAPPY_BOID_GEOMETRY_HPP_
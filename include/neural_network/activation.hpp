@@ -0,0 +1,288 @@
+
+#ifndef NEURAL_NETWORK_ACTIVATION_HPP_
+#define NEURAL_NETWORK_ACTIVATION_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define NEURAL_NETWORK_ACTIVATION_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace neural_network {
+
+// activation functions built into the networks; they are evaluated over
+// whole arrays of values without an indirect call per node
+// custom calls the activation function of the network instead
+enum class activation_type : std::uint8_t {
+	custom,
+	identity,
+	step,       // (value < parameter) ? 0 : 1
+	sigmoid,
+	tanh,
+	relu,
+	leaky_relu, // (value < 0) ? value * parameter : value
+};
+
+template <class T>
+struct builtin_activation {
+	activation_type type = activation_type::custom;
+	T parameter = T();
+};
+
+// the parameter used when none is given: the slope of leaky_relu, the
+// threshold of step
+template <class T>
+constexpr T default_activation_parameter(activation_type type) {
+	return (type == activation_type::leaky_relu) ? static_cast<T>(0.01) : T();
+}
+
+// a run of plan.order[first, last) over the consecutive slots from slot on,
+// all of one activation type and none an input of another; a network sums
+// the whole run, then activates it as one array
+struct activation_segment {
+	std::size_t first;
+	std::size_t last;
+	std::size_t slot;
+	activation_type type;
+
+	std::size_t size() const { return last - first; }
+};
+
+// type_of(slot) returns the activation type of a slot
+template <class Plan, class TypeOf>
+std::vector<activation_segment> make_activation_segments(const Plan &plan, TypeOf &&type_of) {
+	std::vector<activation_segment> segments;
+
+	for (std::size_t i = 0; i < plan.order.size(); ++i) {
+		const auto slot = plan.order[i];
+		const activation_type type = type_of(slot);
+
+		if (!segments.empty()) {
+			auto &segment = segments.back();
+			bool joins = (segment.type == type) && (slot == segment.slot + segment.size());
+			for (auto edge = plan.offsets[i]; joins && (edge < plan.offsets[i + 1]); ++edge) {
+				joins = (plan.inputs[edge] < segment.slot) || (plan.inputs[edge] >= slot);
+			}
+			if (joins) {
+				segment.last = i + 1;
+				continue;
+			}
+		}
+		segments.push_back({ i, i + 1, slot, type });
+	}
+	return segments;
+}
+
+namespace detail {
+
+template <class T>
+T exp_approximation(T x) { return std::exp(x); }
+
+template <class T>
+T tanh_approximation(T x) { return std::tanh(x); }
+
+// Cephes expf: within 2 ulp, inputs clamped to [-87, 88]
+inline float exp_approximation(float x) {
+	x = std::fmin(std::fmax(x, -87.0f), 88.0f);
+
+	const auto fx = std::floor(x * 1.44269504088896341f + 0.5f);
+	x = x - fx * 0.693359375f;
+	x = x - fx * -2.12194440e-4f;
+
+	auto y = 1.9875691500e-4f;
+	y = y * x + 1.3981999507e-3f;
+	y = y * x + 8.3334519073e-3f;
+	y = y * x + 4.1665795894e-2f;
+	y = y * x + 1.6666665459e-1f;
+	y = y * x + 5.0000001201e-1f;
+	y = y * (x * x) + (x + 1.0f);
+
+	const auto bits = static_cast<std::uint32_t>(static_cast<std::int32_t>(fx) + 127) << 23;
+	float scale;
+	std::memcpy(&scale, &bits, sizeof(scale));
+	return y * scale;
+}
+
+// Cephes tanhf: a polynomial below 0.625, exp() above
+inline float tanh_approximation(float x) {
+	const auto ax = std::fabs(x);
+	if (ax < 0.625f) {
+		const auto z = x * x;
+		auto y = -5.70498872745e-3f;
+		y = y * z + 2.06390887954e-2f;
+		y = y * z - 5.37397155531e-2f;
+		y = y * z + 1.33314422036e-1f;
+		y = y * z - 3.33332819422e-1f;
+		return (y * z) * x + x;
+	}
+	return std::copysign(1.0f - 2.0f / (exp_approximation(2.0f * ax) + 1.0f), x);
+}
+
+template <class T, class Op>
+void transform_values(T *values, std::size_t count, const T *parameters, std::size_t parameter_stride, Op op) {
+	for (std::size_t i = 0; i < count; ++i) {
+		values[i] = op(values[i], parameters[i * parameter_stride]);
+	}
+}
+
+// values[i] = f(values[i]) for count values; parameters holds one parameter
+// per value, or a single one for all of them when parameter_stride is 0
+template <class T>
+void apply_activation(activation_type type, T *values, std::size_t count, const T *parameters, std::size_t parameter_stride) {
+	switch (type) {
+	case activation_type::step:
+		transform_values(values, count, parameters, parameter_stride, [](T x, T p) { return (x < p) ? T(0) : T(1); });
+		break;
+
+	case activation_type::sigmoid:
+		transform_values(values, count, parameters, parameter_stride, [](T x, T) { return T(1) / (T(1) + exp_approximation(-x)); });
+		break;
+
+	case activation_type::tanh:
+		transform_values(values, count, parameters, parameter_stride, [](T x, T) { return tanh_approximation(x); });
+		break;
+
+	case activation_type::relu:
+		transform_values(values, count, parameters, parameter_stride, [](T x, T) { return (x < T(0)) ? T(0) : x; });
+		break;
+
+	case activation_type::leaky_relu:
+		transform_values(values, count, parameters, parameter_stride, [](T x, T p) { return (x < T(0)) ? x * p : x; });
+		break;
+
+	default:
+		break;
+	}
+}
+
+#if NEURAL_NETWORK_ACTIVATION_AVX2
+
+inline __m256 exp_approximation(__m256 x) {
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.0f)), _mm256_set1_ps(88.0f));
+
+	const auto fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f), _mm256_set1_ps(0.5f)));
+	x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(0.693359375f), x);
+	x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(-2.12194440e-4f), x);
+
+	auto y = _mm256_set1_ps(1.9875691500e-4f);
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507e-3f));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073e-3f));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894e-2f));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459e-1f));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201e-1f));
+	y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+	const auto bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(y, _mm256_castsi256_ps(bits));
+}
+
+// both branches of the scalar version, blended
+inline __m256 tanh_approximation(__m256 x) {
+	const auto sign = _mm256_set1_ps(-0.0f);
+	const auto ax = _mm256_andnot_ps(sign, x);
+
+	const auto z = _mm256_mul_ps(x, x);
+	auto y = _mm256_set1_ps(-5.70498872745e-3f);
+	y = _mm256_fmadd_ps(y, z, _mm256_set1_ps(2.06390887954e-2f));
+	y = _mm256_fmadd_ps(y, z, _mm256_set1_ps(-5.37397155531e-2f));
+	y = _mm256_fmadd_ps(y, z, _mm256_set1_ps(1.33314422036e-1f));
+	y = _mm256_fmadd_ps(y, z, _mm256_set1_ps(-3.33332819422e-1f));
+	const auto small = _mm256_fmadd_ps(_mm256_mul_ps(y, z), x, x);
+
+	const auto one = _mm256_set1_ps(1.0f);
+	const auto e = exp_approximation(_mm256_add_ps(ax, ax));
+	const auto large = _mm256_sub_ps(one, _mm256_div_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(e, one)));
+
+	return _mm256_blendv_ps(
+		_mm256_or_ps(large, _mm256_and_ps(sign, x)),
+		small,
+		_mm256_cmp_ps(ax, _mm256_set1_ps(0.625f), _CMP_LT_OQ)
+	);
+}
+
+// eight values per pass; the tail goes through a padded block, so a value
+// comes out the same wherever it is in the array
+template <class Op>
+void transform_values(float *values, std::size_t count, const float *parameters, std::size_t parameter_stride, Op op) {
+	auto load_parameters = [&](std::size_t i) {
+		return (parameter_stride == 0) ? _mm256_set1_ps(*parameters) : _mm256_loadu_ps(parameters + i);
+	};
+
+	std::size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		_mm256_storeu_ps(values + i, op(_mm256_loadu_ps(values + i), load_parameters(i)));
+	}
+
+	if (i < count) {
+		alignas(32) float block[8] = {};
+		alignas(32) float block_parameters[8] = {};
+		for (std::size_t k = 0; k < count - i; ++k) {
+			block[k] = values[i + k];
+			block_parameters[k] = parameters[(i + k) * parameter_stride];
+		}
+		_mm256_store_ps(block, op(_mm256_load_ps(block), _mm256_load_ps(block_parameters)));
+		for (std::size_t k = 0; k < count - i; ++k) {
+			values[i + k] = block[k];
+		}
+	}
+}
+
+inline void apply_activation(activation_type type, float *values, std::size_t count, const float *parameters, std::size_t parameter_stride) {
+	const auto zero = _mm256_setzero_ps();
+	const auto one = _mm256_set1_ps(1.0f);
+
+	switch (type) {
+	case activation_type::step:
+		transform_values(values, count, parameters, parameter_stride, [&](__m256 x, __m256 p) {
+			return _mm256_and_ps(_mm256_cmp_ps(x, p, _CMP_NLT_UQ), one);
+		});
+		break;
+
+	case activation_type::sigmoid:
+		transform_values(values, count, parameters, parameter_stride, [&](__m256 x, __m256) {
+			return _mm256_div_ps(one, _mm256_add_ps(one, exp_approximation(_mm256_sub_ps(zero, x))));
+		});
+		break;
+
+	case activation_type::tanh:
+		transform_values(values, count, parameters, parameter_stride, [&](__m256 x, __m256) {
+			return tanh_approximation(x);
+		});
+		break;
+
+	case activation_type::relu:
+		transform_values(values, count, parameters, parameter_stride, [&](__m256 x, __m256) {
+			return _mm256_blendv_ps(x, zero, _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+		});
+		break;
+
+	case activation_type::leaky_relu:
+		transform_values(values, count, parameters, parameter_stride, [&](__m256 x, __m256 p) {
+			return _mm256_blendv_ps(x, _mm256_mul_ps(x, p), _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+		});
+		break;
+
+	default:
+		break;
+	}
+}
+
+#endif // NEURAL_NETWORK_ACTIVATION_AVX2
+
+// one value through apply_activation(), for the paths that go node by node
+template <class T>
+T activate(activation_type type, T value, T parameter) {
+	apply_activation(type, &value, 1, &parameter, 0);
+	return value;
+}
+
+} // namespace detail
+
+} // namespace neural_network
+
+#endif // NEURAL_NETWORK_ACTIVATION_HPP_
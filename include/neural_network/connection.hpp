@@ -2,11 +2,13 @@
 #ifndef NEURAL_NETWORK_CONNECTION_HPP_
 #define NEURAL_NETWORK_CONNECTION_HPP_
 
+#include <cstddef>
+
 namespace neural_network {
 
 class connection {
 public:
-	using index_type = size_t;
+	using index_type = std::size_t;
 	using weight_type = float;
 
 public:
@@ -0,0 +1,531 @@
+
+#ifndef NEURAL_NETWORK_DENSE_NETWORK_HPP_
+#define NEURAL_NETWORK_DENSE_NETWORK_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define NEURAL_NETWORK_DENSE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#include "utility/span.hpp"
+#include "utility/aligned_allocator.hpp"
+#include "utility/thread_pool.hpp"
+
+#include "activation.hpp"
+#include "network.hpp"
+#include "packed_network.hpp"
+
+namespace neural_network {
+
+namespace detail {
+
+// values per 32 byte register; rows are padded to a multiple of it
+constexpr std::size_t dense_lane_size = 8;
+
+constexpr std::size_t dense_stride(std::size_t size) {
+	return (size + dense_lane_size - 1) / dense_lane_size * dense_lane_size;
+}
+
+// for count samples, output[r] = bias[r] + dot(row r, input) over rows rows
+// of stride values; sample s is at input + s * stride and at
+// output + s * output_stride, the padding of the rows and inputs must be zero
+// a row is loaded once and used for every sample
+template <class T>
+void dense_forward(const T *weights, const T *bias, const T *input, T *output, std::size_t rows, std::size_t stride, std::size_t count, std::size_t output_stride) {
+	for (std::size_t r = 0; r < rows; ++r) {
+		const auto *row = weights + r * stride;
+
+		for (std::size_t sample = 0; sample < count; ++sample) {
+			const auto *x = input + sample * stride;
+
+			// one partial sum per lane, like the simd kernel
+			T sums[dense_lane_size] = {};
+			for (std::size_t i = 0; i < stride; i += dense_lane_size) {
+				for (std::size_t lane = 0; lane < dense_lane_size; ++lane) {
+					sums[lane] += row[i + lane] * x[i + lane];
+				}
+			}
+
+			T sum = bias[r];
+			for (auto partial : sums) {
+				sum += partial;
+			}
+			output[sample * output_stride + r] = sum;
+		}
+	}
+}
+
+#if NEURAL_NETWORK_DENSE_AVX2
+
+inline float horizontal_sum(__m256 v) {
+	auto sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+	return _mm_cvtss_f32(sum);
+}
+
+// four rows per pass share every load of the input; the rows stay in the
+// cache while every sample goes through them
+inline void dense_forward(const float *weights, const float *bias, const float *input, float *output, std::size_t rows, std::size_t stride, std::size_t count, std::size_t output_stride) {
+	std::size_t r = 0;
+	for (; r + 4 <= rows; r += 4) {
+		const auto *row = weights + r * stride;
+
+		for (std::size_t sample = 0; sample < count; ++sample) {
+			const auto *in = input + sample * stride;
+			auto *out = output + sample * output_stride + r;
+
+			auto sum0 = _mm256_setzero_ps();
+			auto sum1 = _mm256_setzero_ps();
+			auto sum2 = _mm256_setzero_ps();
+			auto sum3 = _mm256_setzero_ps();
+			for (std::size_t i = 0; i < stride; i += dense_lane_size) {
+				const auto x = _mm256_load_ps(in + i);
+				sum0 = _mm256_fmadd_ps(_mm256_load_ps(row + i), x, sum0);
+				sum1 = _mm256_fmadd_ps(_mm256_load_ps(row + stride + i), x, sum1);
+				sum2 = _mm256_fmadd_ps(_mm256_load_ps(row + stride * 2 + i), x, sum2);
+				sum3 = _mm256_fmadd_ps(_mm256_load_ps(row + stride * 3 + i), x, sum3);
+			}
+			out[0] = bias[r] + horizontal_sum(sum0);
+			out[1] = bias[r + 1] + horizontal_sum(sum1);
+			out[2] = bias[r + 2] + horizontal_sum(sum2);
+			out[3] = bias[r + 3] + horizontal_sum(sum3);
+		}
+	}
+
+	for (; r < rows; ++r) {
+		const auto *row = weights + r * stride;
+
+		for (std::size_t sample = 0; sample < count; ++sample) {
+			const auto *in = input + sample * stride;
+
+			auto sum = _mm256_setzero_ps();
+			for (std::size_t i = 0; i < stride; i += dense_lane_size) {
+				sum = _mm256_fmadd_ps(_mm256_load_ps(row + i), _mm256_load_ps(in + i), sum);
+			}
+			output[sample * output_stride + r] = bias[r] + horizontal_sum(sum);
+		}
+	}
+}
+
+#endif // NEURAL_NETWORK_DENSE_AVX2
+
+} // namespace detail
+
+// a fully connected layer; weights are a row-major output_size() x
+// stride() matrix on 64 byte boundaries, zero padded past input_size()
+template <class T = float>
+class dense_layer {
+public:
+	using value_type = T;
+	using matrix_type = std::vector<value_type, utility::aligned_allocator<value_type, 64>>;
+	using vector_type = std::vector<value_type, utility::aligned_allocator<value_type, 64>>;
+
+public:
+	dense_layer(std::size_t input_size, std::size_t output_size)
+		: _input_size(input_size), _output_size(output_size), _stride(detail::dense_stride(input_size)),
+		_weights(output_size * _stride, value_type()), _bias(output_size, value_type()) {}
+
+	std::size_t input_size() const { return _input_size; }
+	std::size_t output_size() const { return _output_size; }
+
+	// values per row, padding included
+	std::size_t stride() const { return _stride; }
+
+	value_type weight(std::size_t out, std::size_t in) const { return _weights[out * _stride + in]; }
+	void set_weight(std::size_t out, std::size_t in, value_type weight) { _weights[out * _stride + in] = weight; }
+
+	// the input_size() weights into out
+	utility::span<const value_type> row(std::size_t out) const { return { _weights.data() + out * _stride, _input_size }; }
+	utility::span<value_type> row(std::size_t out) { return { _weights.data() + out * _stride, _input_size }; }
+
+	utility::span<const value_type> bias() const { return _bias; }
+	utility::span<value_type> bias() { return _bias; }
+
+	const matrix_type &weights() const { return _weights; }
+
+	// output = weights * input + bias; input holds stride() values on a 64
+	// byte boundary, the ones past input_size() zero
+	void forward(const value_type *input, value_type *output) const {
+		detail::dense_forward(_weights.data(), _bias.data(), input, output, _output_size, _stride, 1, 0);
+	}
+
+	// forward() for count inputs stride() values apart, writing outputs
+	// output_stride values apart
+	void forward(const value_type *input, value_type *output, std::size_t count, std::size_t output_stride) const {
+		detail::dense_forward(_weights.data(), _bias.data(), input, output, _output_size, _stride, count, output_stride);
+	}
+
+private:
+	std::size_t _input_size;
+	std::size_t _output_size;
+	std::size_t _stride;
+	matrix_type _weights;
+	vector_type _bias;
+};
+
+// fully connected layers evaluated with matrix-vector products; the
+// activation function is applied to every layer but the input one, like
+// base_network::process()
+template <class T = float>
+class dense_network {
+public:
+	using value_type = T;
+	using layer_type = dense_layer<value_type>;
+	using layer_list_type = std::vector<layer_type>;
+	using vector_type = typename layer_type::vector_type;
+
+	using activation_function_type = std::function<value_type(value_type)>;
+	using builtin_activation_type = builtin_activation<value_type>;
+
+public:
+	dense_network() {}
+
+	// node counts from the input layer to the output layer
+	explicit dense_network(const std::vector<std::size_t> &sizes) {
+		if (sizes.empty()) return;
+
+		_values.emplace_back(detail::dense_stride(sizes.front()), value_type());
+		_sizes.push_back(sizes.front());
+		for (std::size_t i = 1; i < sizes.size(); ++i) {
+			push_layer(sizes[i]);
+		}
+	}
+
+	// appends a layer of size nodes fed by the current output layer
+	layer_type &push_layer(std::size_t size) {
+		if (_values.empty()) {
+			throw std::logic_error("neural_network::dense_network::push_layer");
+		}
+		_layers.emplace_back(_sizes.back(), size);
+		_activations.push_back(_default_activation);
+		_values.emplace_back(detail::dense_stride(size), value_type());
+		_sizes.push_back(size);
+		return _layers.back();
+	}
+
+	// weighted layers, the input layer not included
+	std::size_t layer_size() const { return _layers.size(); }
+
+	const layer_list_type &layers() const { return _layers; }
+	layer_list_type &layers() { return _layers; }
+
+	const layer_type &layer(std::size_t index) const { return _layers[index]; }
+	layer_type &layer(std::size_t index) { return _layers[index]; }
+
+	std::size_t input_size() const { return _sizes.empty() ? 0 : _sizes.front(); }
+	std::size_t output_size() const { return _sizes.empty() ? 0 : _sizes.back(); }
+
+	// for the layers whose activation is activation_type::custom, the default
+	void set_activation_function(activation_function_type function) { _activation_function = function; }
+
+	// a built-in activation for every layer, including the ones pushed later
+	void set_activation(activation_type type, value_type parameter) {
+		_default_activation = { type, parameter };
+		std::fill(_activations.begin(), _activations.end(), _default_activation);
+	}
+
+	void set_activation(activation_type type) {
+		set_activation(type, default_activation_parameter<value_type>(type));
+	}
+
+	// index as in layer()
+	void set_layer_activation(std::size_t index, activation_type type, value_type parameter) {
+		_activations[index] = { type, parameter };
+	}
+
+	void set_layer_activation(std::size_t index, activation_type type) {
+		set_layer_activation(index, type, default_activation_parameter<value_type>(type));
+	}
+
+	const builtin_activation_type &layer_activation(std::size_t index) const { return _activations[index]; }
+
+	// node values of layer index, 0 being the input layer
+	utility::span<const value_type> values(std::size_t index) const { return { _values[index].data(), _sizes[index] }; }
+	utility::span<value_type> values(std::size_t index) { return { _values[index].data(), _sizes[index] }; }
+
+	utility::span<value_type> inputs() { return values(0); }
+	utility::span<const value_type> outputs() const { return values(_sizes.size() - 1); }
+
+	void process() {
+		for (std::size_t i = 0; i < _layers.size(); ++i) {
+			auto *output = _values[i + 1].data();
+			_layers[i].forward(_values[i].data(), output);
+			activate(i, output, _sizes[i + 1]);
+		}
+	}
+
+	// samples evaluated together by process_batch(); each layer's weights
+	// are read once per tile
+	static constexpr std::size_t batch_tile_size() { return 32; }
+
+	// process() for every row of inputs, a row-major samples x input_size()
+	// matrix, into outputs, a samples x output_size() matrix
+	// tiles are split across pool when one is given; a custom activation
+	// function is then called from several threads at once
+	void process_batch(utility::span<const value_type> inputs, utility::span<value_type> outputs, utility::thread_pool *pool = nullptr) const {
+		const auto input_count = input_size();
+		const auto output_count = output_size();
+		const auto samples = (input_count > 0) ? (inputs.size() / input_count) : 0;
+		if ((_layers.empty()) || (samples * input_count != inputs.size()) || (samples * output_count != outputs.size())) {
+			throw std::invalid_argument("neural_network::dense_network::process_batch");
+		}
+
+		const auto tiles = (samples + batch_tile_size() - 1) / batch_tile_size();
+		auto run = [&](std::size_t first_tile, std::size_t last_tile) {
+			// one padded row per sample and layer
+			std::vector<vector_type> buffers;
+			buffers.reserve(_sizes.size());
+			for (auto size : _sizes) {
+				buffers.emplace_back(detail::dense_stride(size) * batch_tile_size(), value_type());
+			}
+
+			for (auto tile = first_tile; tile < last_tile; ++tile) {
+				const auto first = tile * batch_tile_size();
+				const auto count = std::min(batch_tile_size(), samples - first);
+				process_tile(inputs.data() + first * input_count, outputs.data() + first * output_count, count, buffers);
+			}
+		};
+
+		if ((pool == nullptr) || (tiles < 2)) {
+			run(0, tiles);
+
+		} else {
+			const auto grain = std::max<std::size_t>(tiles / ((pool->size() + 1) * 4), 1);
+			pool->parallel_for(0, tiles, grain, run);
+		}
+	}
+
+	// samples x output_size() outputs
+	std::vector<value_type> process_batch(utility::span<const value_type> inputs, utility::thread_pool *pool = nullptr) const {
+		std::vector<value_type> outputs((input_size() > 0) ? (inputs.size() / input_size() * output_size()) : 0);
+		process_batch(inputs, outputs, pool);
+		return outputs;
+	}
+
+	std::size_t memory_usage() const {
+		std::size_t bytes = 0;
+		for (const auto &layer : _layers) {
+			bytes += (layer.weights().capacity() + layer.output_size()) * sizeof(value_type);
+		}
+		for (const auto &values : _values) {
+			bytes += values.capacity() * sizeof(value_type);
+		}
+		return bytes;
+	}
+
+protected:
+	void process_tile(const value_type *inputs, value_type *outputs, std::size_t count, std::vector<vector_type> &buffers) const {
+		const auto input_count = input_size();
+		const auto input_stride = detail::dense_stride(input_count);
+		for (std::size_t sample = 0; sample < count; ++sample) {
+			std::copy(inputs + sample * input_count, inputs + (sample + 1) * input_count, buffers[0].data() + sample * input_stride);
+		}
+
+		for (std::size_t i = 0; i < _layers.size(); ++i) {
+			const auto size = _sizes[i + 1];
+			const auto stride = detail::dense_stride(size);
+			auto *output = buffers[i + 1].data();
+			_layers[i].forward(buffers[i].data(), output, count, stride);
+
+			// row by row, the padding must stay zero
+			for (std::size_t sample = 0; sample < count; ++sample) {
+				activate(i, output + sample * stride, size);
+			}
+		}
+
+		const auto output_count = output_size();
+		const auto output_stride = detail::dense_stride(output_count);
+		const auto &last = buffers.back();
+		for (std::size_t sample = 0; sample < count; ++sample) {
+			std::copy(last.data() + sample * output_stride, last.data() + sample * output_stride + output_count, outputs + sample * output_count);
+		}
+	}
+
+	// the activation of layer index over size values
+	void activate(std::size_t index, value_type *values, std::size_t size) const {
+		const auto &activation = _activations[index];
+		if (activation.type != activation_type::custom) {
+			detail::apply_activation(activation.type, values, size, &activation.parameter, 0);
+
+		} else if (_activation_function) {
+			for (std::size_t k = 0; k < size; ++k) {
+				values[k] = _activation_function(values[k]);
+			}
+		}
+	}
+
+private:
+	layer_list_type _layers;
+	std::vector<std::size_t> _sizes;
+	std::vector<vector_type> _values;
+	activation_function_type _activation_function;
+	builtin_activation_type _default_activation;
+	std::vector<builtin_activation_type> _activations;
+};
+
+namespace detail {
+
+// layers are node id lists in evaluation order; every node of a layer must
+// have exactly one connection from every node of the layer before it, and
+// there must be no other connection
+// activation_of(node id) returns the built-in activation of a node; the
+// nodes of a layer must share it, except for the step thresholds, which
+// become the bias
+template <class T, class Id, class Connections, class ActivationOf>
+dense_network<T> make_dense_network(const std::vector<std::vector<Id>> &layers, const Connections &connections, ActivationOf &&activation_of) {
+	if (layers.size() < 2) {
+		throw std::invalid_argument("neural_network::make_dense_network: needs two layers");
+	}
+
+	struct position {
+		std::size_t layer;
+		std::size_t index;
+	};
+	std::unordered_map<Id, position> positions;
+
+	std::vector<std::size_t> sizes;
+	std::size_t expected = 0;
+	for (std::size_t layer = 0; layer < layers.size(); ++layer) {
+		sizes.push_back(layers[layer].size());
+		for (std::size_t index = 0; index < layers[layer].size(); ++index) {
+			positions.emplace(layers[layer][index], position { layer, index });
+		}
+		if (layer > 0) {
+			expected += layers[layer - 1].size() * layers[layer].size();
+		}
+	}
+
+	dense_network<T> network(sizes);
+
+	std::vector<std::vector<bool>> seen;
+	for (std::size_t layer = 1; layer < layers.size(); ++layer) {
+		seen.emplace_back(layers[layer - 1].size() * layers[layer].size(), false);
+	}
+
+	for (const auto &connection : connections) {
+		auto in = positions.find(static_cast<Id>(connection.in()));
+		auto out = positions.find(static_cast<Id>(connection.out()));
+		if ((in == positions.end()) || (out == positions.end()) || (out->second.layer != in->second.layer + 1)) {
+			throw std::invalid_argument("neural_network::make_dense_network: not a layered network");
+		}
+
+		const auto layer = in->second.layer;
+		auto &&flag = seen[layer][out->second.index * layers[layer].size() + in->second.index];
+		if (flag) {
+			throw std::invalid_argument("neural_network::make_dense_network: duplicate connection");
+		}
+		flag = true;
+
+		network.layer(layer).set_weight(out->second.index, in->second.index, static_cast<T>(connection.weight()));
+	}
+
+	if (connections.size() != expected) {
+		throw std::invalid_argument("neural_network::make_dense_network: layers are not fully connected");
+	}
+
+	for (std::size_t layer = 1; layer < layers.size(); ++layer) {
+		const builtin_activation<T> first = activation_of(layers[layer].front());
+		auto bias = network.layer(layer - 1).bias();
+
+		for (std::size_t index = 0; index < layers[layer].size(); ++index) {
+			const builtin_activation<T> activation = activation_of(layers[layer][index]);
+			if (activation.type != first.type) {
+				throw std::invalid_argument("neural_network::make_dense_network: mixed activations in a layer");
+			}
+
+			if (activation.type == activation_type::step) {
+				bias[index] = -activation.parameter;
+
+			} else if ((activation.type == activation_type::leaky_relu) && (activation.parameter != first.parameter)) {
+				throw std::invalid_argument("neural_network::make_dense_network: mixed activations in a layer");
+			}
+		}
+		network.set_layer_activation(layer - 1, first.type, (first.type == activation_type::step) ? T() : first.parameter);
+	}
+	return network;
+}
+
+} // namespace detail
+
+// the dense form of a network whose layers, in layer id order, are fully
+// connected to the next one; it computes what process() computes after
+// reset(), with activation in place of the node based activation function
+// built-in activations carry over per layer
+// throws std::invalid_argument for any other topology
+template <class Node, class Connection>
+auto make_dense_network(
+	const base_network<Node, Connection> &network,
+	typename dense_network<typename Node::value_type>::activation_function_type activation = nullptr
+) {
+	using network_type = base_network<Node, Connection>;
+	using value_type = typename network_type::node_value_type;
+	using node_id_type = typename network_type::node_id_type;
+
+	std::unordered_map<const Node *, node_id_type> ids;
+	for (const auto &pair : network.node_map()) {
+		if (auto node = pair.second.lock()) {
+			ids.emplace(node.get(), pair.first);
+		}
+	}
+
+	std::map<typename network_type::layer_id_type, std::vector<node_id_type>> ordered;
+	for (const auto &pair : network.layer_map()) {
+		auto &layer = ordered[pair.first];
+		for (const auto &handle : pair.second) {
+			auto node = handle.lock();
+			auto it = node ? ids.find(node.get()) : ids.end();
+			if (it == ids.end()) {
+				throw std::invalid_argument("neural_network::make_dense_network: unknown node");
+			}
+			layer.push_back(it->second);
+		}
+	}
+
+	std::vector<std::vector<node_id_type>> layers;
+	for (auto &pair : ordered) {
+		if (!pair.second.empty()) layers.push_back(std::move(pair.second));
+	}
+
+	auto result = detail::make_dense_network<value_type>(layers, network.connection_list(), [&](node_id_type id) { return network.node_activation(id); });
+	result.set_activation_function(activation);
+	return result;
+}
+
+template <class T, class... Extras>
+auto make_dense_network(
+	const basic_packed_network<T, Extras...> &network,
+	typename dense_network<T>::activation_function_type activation = nullptr
+) {
+	using network_type = basic_packed_network<T, Extras...>;
+	using node_id_type = typename network_type::node_id_type;
+
+	std::map<typename network_type::layer_id_type, std::vector<node_id_type>> ordered;
+	for (const auto &pair : network.layer_map()) {
+		auto &layer = ordered[pair.first];
+		for (auto id = pair.second.first; id < pair.second.last; ++id) {
+			layer.push_back(id);
+		}
+	}
+
+	std::vector<std::vector<node_id_type>> layers;
+	for (auto &pair : ordered) {
+		if (!pair.second.empty()) layers.push_back(std::move(pair.second));
+	}
+
+	auto result = detail::make_dense_network<T>(layers, network.connection_list(), [&](node_id_type id) { return network.node_activation(id); });
+	result.set_activation_function(activation);
+	return result;
+}
+
+} // namespace neural_network
+
+#endif // NEURAL_NETWORK_DENSE_NETWORK_HPP_
@@ -2,13 +2,18 @@
 #ifndef NEURAL_NETWORK_NETWORK_HPP_
 #define NEURAL_NETWORK_NETWORK_HPP_
 
+#include <cstddef>
 #include <memory>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <functional>
+#include <algorithm>
 
 #include "neuron.hpp"
 #include "connection.hpp"
+#include "plan.hpp"
+#include "activation.hpp"
 
 namespace neural_network {
 
@@ -33,26 +38,78 @@ public:
 	using connection_index_type = typename connection_list_type::size_type;
 
 	using activation_function_type = std::function<node_value_type(node_pointer)>;
+	using builtin_activation_type = builtin_activation<node_value_type>;
+
+	using weight_type = typename connection_type::weight_type;
+	using plan_type = execution_plan<weight_type>;
+	using slot_type = typename plan_type::slot_type;
 
 public:
 	base_network() {}
 
+	// the mutable accessors may change the topology, so they drop the plan
 	const node_list_type &node_list() const { return _node_list; }
-	node_list_type &node_list() { return const_cast<node_list_type &>(static_cast<const base_network *>(this)->node_list()); }
+	node_list_type &node_list() { invalidate(); return _node_list; }
 
 	const node_map_type &node_map() const { return _node_map; }
-	node_map_type &node_map() { return const_cast<node_map_type &>(static_cast<const base_network *>(this)->node_map()); }
+	node_map_type &node_map() { invalidate(); return _node_map; }
 
 	const layer_map_type &layer_map() const { return _layer_map; }
 	layer_map_type &layer_map() { return const_cast<layer_map_type &>(static_cast<const base_network *>(this)->layer_map()); }
 
 	const connection_list_type &connection_list() const { return _connection_list; }
-	connection_list_type &connection_list() { return const_cast<connection_list_type &>(static_cast<const base_network *>(this)->connection_list()); }
+	connection_list_type &connection_list() { invalidate(); return _connection_list; }
 
+	// for the nodes whose activation is activation_type::custom, the default;
+	// it is called with a node_pointer per node and pass, which is the slow
+	// path next to the built-in activations
 	void set_activation_function(activation_function_type function) { _activation_function = function; }
 
+	// a built-in activation for every node, including the ones pushed later
+	void set_activation(activation_type type, node_value_type parameter) {
+		_default_activation = { type, parameter };
+		_activations.clear();
+		invalidate();
+	}
+
+	void set_activation(activation_type type) {
+		set_activation(type, default_activation_parameter<node_value_type>(type));
+	}
+
+	void set_layer_activation(layer_id_type id, activation_type type, node_value_type parameter) {
+		std::unordered_set<const node_type *> nodes;
+		for (const auto &handle : layer(id)) {
+			if (auto node = handle.lock()) nodes.insert(node.get());
+		}
+		for (const auto &pair : _node_map) {
+			auto node = pair.second.lock();
+			if (node && (nodes.count(node.get()) > 0)) {
+				_activations[pair.first] = { type, parameter };
+			}
+		}
+		invalidate();
+	}
+
+	void set_layer_activation(layer_id_type id, activation_type type) {
+		set_layer_activation(id, type, default_activation_parameter<node_value_type>(type));
+	}
+
+	void set_node_activation(node_id_type id, activation_type type, node_value_type parameter) {
+		_activations[id] = { type, parameter };
+		invalidate();
+	}
+
+	void set_node_activation(node_id_type id, activation_type type) {
+		set_node_activation(id, type, default_activation_parameter<node_value_type>(type));
+	}
+
+	builtin_activation_type node_activation(node_id_type id) const {
+		auto it = _activations.find(id);
+		return (it != _activations.end()) ? it->second : _default_activation;
+	}
+
 	const node_pointer node(node_id_type id) const { return node_map().at(id).lock(); }
-	node_pointer node(node_id_type id) { return const_cast<node_pointer &>(static_cast<const base_network *>(this)->node(id)); }
+	node_pointer node(node_id_type id) { return _node_map.at(id).lock(); }
 
 	const layer_type &layer(layer_id_type id) const { return layer_map().at(id); }
 	layer_type &layer(layer_id_type id) { return const_cast<layer_type &>(static_cast<const base_network *>(this)->layer(id)); }
@@ -79,46 +136,120 @@ public:
 		connection_list().emplace_back(std::forward<Args>(args)...);
 	}
 
+	// out nodes are evaluated in topological order, each one once: the
+	// weighted inputs are added to its value, then the activation function
+	// is applied; nodes on a cycle read the value their inputs had so far
+	// built-in activations are applied once per segment of the plan
 	void process() {
-		auto list = listing_connections();
-		auto it = list.begin();
-		while (!list.empty()) {
-			auto out_node = node((*it)->out());
-			if (!out_node) break;
+		if (!compiled()) compile();
+
+		const auto &plan = _plan;
+		auto &values = _plan_values;
+		for (slot_type slot = 0; slot < _plan_nodes.size(); ++slot) {
+			values[slot] = _plan_nodes[slot]->value();
+		}
+
+		for (const auto &segment : _segments) {
+			const bool custom = (segment.type == activation_type::custom);
 
-			for (auto pout_connection : listing_connections_out((*it)->out())) {
-				if (pout_connection == nullptr) continue;
-				process_connection(pout_connection);
+			for (auto i = segment.first; i < segment.last; ++i) {
+				const auto slot = plan.order[i];
 
-				list.erase(std::remove(list.begin(), list.end(), pout_connection), list.end());
+				auto value = values[slot];
+				for (auto edge = plan.offsets[i]; edge < plan.offsets[i + 1]; ++edge) {
+					value += values[plan.inputs[edge]] * plan.weights[edge];
+				}
+
+				const auto &out_node = _plan_nodes[slot];
+				out_node->set_value(value);
+				if (custom) {
+					value = activation(out_node);
+					out_node->set_value(value);
+				}
+				values[slot] = value;
+			}
+
+			if (!custom) {
+				detail::apply_activation(segment.type, values.data() + segment.slot, segment.size(), _plan_parameters.data() + segment.slot, 1);
+				for (auto slot = segment.slot; slot < segment.slot + segment.size(); ++slot) {
+					_plan_nodes[slot]->set_value(values[slot]);
+				}
 			}
-			out_node->set_value(activation(out_node));
-			it = list.begin();
 		}
 	}
 
+	// fn(connection *) for every connection in process() order; fn may change
+	// weights, changes to in() or out() need invalidate()
 	void learn_connections(std::function<void(connection_type*)> fn) {
 		if (!fn) return;
+		if (!compiled()) compile();
+
+		auto &plan = _plan;
+		for (std::size_t i = 0; i < plan.order.size(); ++i) {
+			for (auto edge = plan.offsets[i]; edge < plan.offsets[i + 1]; ++edge) {
+				auto &connection = _connection_list[plan.connections[edge]];
+				fn(&connection);
+				plan.weights[edge] = connection.weight();
+			}
 
-		auto list = listing_connections();
-		auto it = list.begin();
-		while (!list.empty()) {
-			auto out_node = node((*it)->out());
-			if (!out_node) break;
+			const auto slot = plan.order[i];
+			_plan_nodes[slot]->set_value(activation(slot));
+		}
+	}
 
-			for (auto pout_connection : listing_connections_out((*it)->out())) {
-				if (pout_connection == nullptr) continue;
-				fn(pout_connection);
+	// flattens the graph into the plan used by process(); called on demand
+	// after push_node() or push_connection()
+	// slots are positions in node_list(), connections to or from unknown
+	// node ids are left out
+	void compile() {
+		const auto node_size = _node_list.size();
+
+		std::unordered_map<const node_type *, slot_type> slot_of_node;
+		slot_of_node.reserve(node_size);
+		for (slot_type slot = 0; slot < node_size; ++slot) {
+			slot_of_node.emplace(_node_list[slot].get(), slot);
+		}
 
-				list.erase(std::remove(list.begin(), list.end(), pout_connection), list.end());
+		std::unordered_map<connection_index_type, slot_type> slot_of_id;
+		slot_of_id.reserve(_node_map.size());
+		_plan_types.assign(node_size, _default_activation.type);
+		_plan_parameters.assign(node_size, _default_activation.parameter);
+		for (const auto &pair : _node_map) {
+			if (auto node = pair.second.lock()) {
+				auto it = slot_of_node.find(node.get());
+				if (it != slot_of_node.end()) {
+					slot_of_id.emplace(static_cast<connection_index_type>(pair.first), it->second);
+
+					const auto builtin = node_activation(pair.first);
+					_plan_types[it->second] = builtin.type;
+					_plan_parameters[it->second] = builtin.parameter;
+				}
 			}
-			out_node->set_value(activation(out_node));
-			it = list.begin();
 		}
+
+		_plan = make_execution_plan<weight_type>(
+			node_size,
+			_connection_list,
+			[&](connection_index_type id) {
+				auto it = slot_of_id.find(id);
+				return (it != slot_of_id.end()) ? it->second : plan_type::npos;
+			}
+		);
+		_plan_nodes = _node_list;
+		_plan_values.assign(node_size, node_value_type());
+		_segments = make_activation_segments(_plan, [this](slot_type slot) { return _plan_types[slot]; });
+		_compiled = true;
 	}
 
+	bool compiled() const { return _compiled; }
+
+	// the next process() compiles again
+	void invalidate() { _compiled = false; }
+
+	const plan_type &plan() const { return _plan; }
+
 	void reset(node_value_type value = 0) {
-		for (auto node : node_list()) {
+		for (auto &node : _node_list) {
 			node->set_value(value);
 		}
 	}
@@ -161,14 +292,7 @@ protected:
 		node_list().emplace_back(std::make_shared<node_type>(std::forward<Args>(args)...));
 	}
 
-	void process_connection(const connection_type *connection) {
-		if (connection == nullptr) return;
-		auto in_node = node(connection->in());
-		auto out_node = node(connection->out());
-		out_node->set_value(out_node->value() + in_node->value() * connection->weight());
-	}
-
-	node_value_type activation(node_pointer p) {
+	node_value_type activation(const node_pointer &p) {
 		node_value_type value = p->value();
 
 		if (_activation_function) {
@@ -178,12 +302,30 @@ protected:
 		return value;
 	}
 
+	node_value_type activation(slot_type slot) {
+		const auto type = _plan_types[slot];
+		if (type != activation_type::custom) {
+			return detail::activate(type, _plan_nodes[slot]->value(), _plan_parameters[slot]);
+		}
+		return activation(_plan_nodes[slot]);
+	}
+
 private:
 	node_list_type _node_list;
 	node_map_type _node_map;
 	layer_map_type _layer_map;
 	connection_list_type _connection_list;
 	activation_function_type _activation_function;
+	builtin_activation_type _default_activation;
+	std::unordered_map<node_id_type, builtin_activation_type> _activations;
+
+	plan_type _plan;
+	node_list_type _plan_nodes;
+	std::vector<node_value_type> _plan_values;
+	std::vector<activation_type> _plan_types;
+	std::vector<node_value_type> _plan_parameters;
+	std::vector<activation_segment> _segments;
+	bool _compiled = false;
 };
 
 using network = base_network<>;
@@ -4,6 +4,10 @@
 
 #include "connection.hpp"
 #include "neuron.hpp"
+#include "plan.hpp"
+#include "activation.hpp"
 #include "network.hpp"
+#include "packed_network.hpp"
+#include "dense_network.hpp"
 
 #endif // NEURAL_NETWORK_HPP_
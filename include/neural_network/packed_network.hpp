@@ -0,0 +1,406 @@
+
+#ifndef NEURAL_NETWORK_PACKED_NETWORK_HPP_
+#define NEURAL_NETWORK_PACKED_NETWORK_HPP_
+
+#include <cstddef>
+#include <tuple>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+
+#include "utility/span.hpp"
+#include "utility/thread_pool.hpp"
+
+#include "connection.hpp"
+#include "plan.hpp"
+#include "activation.hpp"
+
+namespace neural_network {
+
+// a network whose neurons are plain values in contiguous arrays indexed by
+// node id, with one more array per extra (e.g. a threshold)
+// a layer is a range of consecutive node ids, inputs and outputs are read
+// and written through spans; nothing is allocated per node
+template <class T = float, class... Extras>
+class basic_packed_network {
+public:
+	using value_type = T;
+	using value_list_type = std::vector<value_type>;
+	using node_id_type = connection::index_type;
+
+	using extras_type = std::tuple<std::vector<Extras>...>;
+
+	// node ids [first, last)
+	struct layer_type {
+		node_id_type first = 0;
+		node_id_type last = 0;
+
+		std::size_t size() const { return last - first; }
+		bool empty() const { return first == last; }
+		bool contains(node_id_type id) const { return (id >= first) && (id < last); }
+	};
+	using layer_id_type = int;
+	using layer_map_type = std::unordered_map<layer_id_type, layer_type>;
+
+	using connection_type = connection;
+	using connection_list_type = std::vector<connection_type>;
+	using connection_index_type = typename connection_list_type::size_type;
+
+	using weight_type = typename connection_type::weight_type;
+	using plan_type = execution_plan<weight_type>;
+
+	// (value after the weighted sum, node id) -> activated value
+	using activation_function_type = std::function<value_type(value_type, node_id_type)>;
+	using builtin_activation_type = builtin_activation<value_type>;
+
+	static constexpr std::size_t extra_size() { return sizeof...(Extras); }
+
+public:
+	basic_packed_network() {}
+
+	std::size_t node_size() const { return _values.size(); }
+
+	utility::span<const value_type> values() const { return _values; }
+	utility::span<value_type> values() { return _values; }
+
+	value_type value(node_id_type id) const { return _values[id]; }
+	void set_value(node_id_type id, value_type value) { _values[id] = value; }
+
+	template <std::size_t Index>
+	utility::span<const std::tuple_element_t<Index, std::tuple<Extras...>>> get_extras() const {
+		return std::get<Index>(_extras);
+	}
+
+	template <std::size_t Index>
+	utility::span<std::tuple_element_t<Index, std::tuple<Extras...>>> get_extras() {
+		return std::get<Index>(_extras);
+	}
+
+	template <std::size_t Index>
+	decltype(auto) extra(node_id_type id) const { return std::get<Index>(_extras)[id]; }
+
+	template <std::size_t Index>
+	decltype(auto) extra(node_id_type id) { return std::get<Index>(_extras)[id]; }
+
+	const layer_map_type &layer_map() const { return _layer_map; }
+
+	const layer_type &layer(layer_id_type id) const { return _layer_map.at(id); }
+
+	// the values of a layer, e.g. to set the inputs or read the outputs
+	utility::span<const value_type> layer_values(layer_id_type id) const {
+		const auto &range = layer(id);
+		return utility::span<const value_type>(_values.data() + range.first, range.size());
+	}
+
+	utility::span<value_type> layer_values(layer_id_type id) {
+		const auto &range = layer(id);
+		return utility::span<value_type>(_values.data() + range.first, range.size());
+	}
+
+	const connection_list_type &connection_list() const { return _connection_list; }
+
+	// may change the topology, so the plan is dropped
+	connection_list_type &connection_list() { invalidate(); return _connection_list; }
+
+	// for the nodes whose activation is activation_type::custom, the default
+	void set_activation_function(activation_function_type function) { _activation_function = function; }
+
+	// a built-in activation for every node, including the ones pushed later
+	void set_activation(activation_type type, value_type parameter) {
+		_default_activation = { type, parameter };
+		std::fill(_activation_types.begin(), _activation_types.end(), type);
+		std::fill(_activation_parameters.begin(), _activation_parameters.end(), parameter);
+		invalidate();
+	}
+
+	void set_activation(activation_type type) {
+		set_activation(type, default_activation_parameter<value_type>(type));
+	}
+
+	void set_layer_activation(layer_id_type id, activation_type type, value_type parameter) {
+		const auto &range = layer(id);
+		for (auto node = range.first; node < range.last; ++node) {
+			set_node_activation(node, type, parameter);
+		}
+	}
+
+	void set_layer_activation(layer_id_type id, activation_type type) {
+		set_layer_activation(id, type, default_activation_parameter<value_type>(type));
+	}
+
+	void set_node_activation(node_id_type id, activation_type type, value_type parameter) {
+		if (_activation_types[id] != type) {
+			_activation_types[id] = type;
+			invalidate();
+		}
+		_activation_parameters[id] = parameter;
+	}
+
+	void set_node_activation(node_id_type id, activation_type type) {
+		set_node_activation(id, type, default_activation_parameter<value_type>(type));
+	}
+
+	builtin_activation_type node_activation(node_id_type id) const {
+		return { _activation_types[id], _activation_parameters[id] };
+	}
+
+	// the step thresholds and leaky_relu slopes by node id; they may be
+	// changed between passes, e.g. while learning
+	utility::span<const value_type> activation_parameters() const { return _activation_parameters; }
+	utility::span<value_type> activation_parameters() { return _activation_parameters; }
+
+	// node ids of a layer must be consecutive; ids in between layers may
+	// stay unused and only cost their slot
+	void push_node(node_id_type id, layer_id_type layer) {
+		push_node(id, layer, value_type(), Extras()...);
+	}
+
+	void push_node(node_id_type id, layer_id_type layer, value_type value, Extras... extras) {
+		auto &range = _layer_map[layer];
+		if (range.empty()) {
+			range = { id, id + 1 };
+
+		} else if (id == range.last) {
+			++range.last;
+
+		} else if (!range.contains(id)) {
+			throw std::invalid_argument("neural_network::packed_network::push_node");
+		}
+
+		if (id >= node_size()) {
+			resize(id + 1);
+		}
+		_values[id] = value;
+		assign_extras(id, std::index_sequence_for<Extras...>(), std::move(extras)...);
+		invalidate();
+	}
+
+	void push_layer(layer_id_type id) {
+		_layer_map.emplace(id, layer_type());
+	}
+
+	template <class... Args>
+	void push_connection(Args&&... args) {
+		_connection_list.emplace_back(std::forward<Args>(args)...);
+		invalidate();
+	}
+
+	void reset(value_type value = 0) {
+		std::fill(_values.begin(), _values.end(), value);
+	}
+
+	// the same evaluation as base_network::process(), over the arrays
+	// built-in activations are applied once per segment, custom ones node by
+	// node as soon as the node is summed
+	void process() {
+		if (!compiled()) compile();
+
+		const auto &plan = _plan;
+		auto *values = _values.data();
+		for (const auto &segment : _segments) {
+			const bool custom = (segment.type == activation_type::custom);
+
+			for (auto i = segment.first; i < segment.last; ++i) {
+				const auto slot = plan.order[i];
+
+				auto value = values[slot];
+				for (auto edge = plan.offsets[i]; edge < plan.offsets[i + 1]; ++edge) {
+					value += values[plan.inputs[edge]] * plan.weights[edge];
+				}
+				values[slot] = custom ? activation(value, slot) : value;
+			}
+
+			if (!custom) {
+				detail::apply_activation(segment.type, values + segment.slot, segment.size(), _activation_parameters.data() + segment.slot, 1);
+			}
+		}
+	}
+
+	// samples evaluated together by process_batch(); each weight is read
+	// once per tile
+	static constexpr std::size_t batch_tile_size() { return 32; }
+
+	// reset(), inputs into input_layer, process() and outputs from
+	// output_layer for every row of inputs, a row-major samples x inputs
+	// matrix, into outputs, a samples x outputs matrix; the node values of
+	// the network are left alone
+	// tiles are split across pool when one is given; a custom activation
+	// function is then called from several threads at once
+	void process_batch(
+		layer_id_type input_layer,
+		layer_id_type output_layer,
+		utility::span<const value_type> inputs,
+		utility::span<value_type> outputs,
+		utility::thread_pool *pool = nullptr
+	) {
+		if (!compiled()) compile();
+
+		const auto &in = layer(input_layer);
+		const auto &out = layer(output_layer);
+		const auto samples = in.empty() ? 0 : (inputs.size() / in.size());
+		if ((samples * in.size() != inputs.size()) || (samples * out.size() != outputs.size())) {
+			throw std::invalid_argument("neural_network::packed_network::process_batch");
+		}
+
+		const auto tiles = (samples + batch_tile_size() - 1) / batch_tile_size();
+		auto run = [&](std::size_t first_tile, std::size_t last_tile) {
+			// slot-major: the values of a node for every sample of the tile are adjacent
+			value_list_type values(node_size() * batch_tile_size());
+			for (auto tile = first_tile; tile < last_tile; ++tile) {
+				const auto first = tile * batch_tile_size();
+				const auto count = std::min(batch_tile_size(), samples - first);
+				process_tile(in, out, inputs.data() + first * in.size(), outputs.data() + first * out.size(), count, values);
+			}
+		};
+
+		if ((pool == nullptr) || (tiles < 2)) {
+			run(0, tiles);
+
+		} else {
+			const auto grain = std::max<std::size_t>(tiles / ((pool->size() + 1) * 4), 1);
+			pool->parallel_for(0, tiles, grain, run);
+		}
+	}
+
+	// fn(connection *) for every connection in process() order; fn may change
+	// weights, changes to in() or out() need invalidate()
+	void learn_connections(std::function<void(connection_type*)> fn) {
+		if (!fn) return;
+		if (!compiled()) compile();
+
+		auto &plan = _plan;
+		for (std::size_t i = 0; i < plan.order.size(); ++i) {
+			for (auto edge = plan.offsets[i]; edge < plan.offsets[i + 1]; ++edge) {
+				auto &connection = _connection_list[plan.connections[edge]];
+				fn(&connection);
+				plan.weights[edge] = connection.weight();
+			}
+
+			const auto slot = plan.order[i];
+			_values[slot] = activation(_values[slot], slot);
+		}
+	}
+
+	// connections to or from ids past node_size() are left out
+	void compile() {
+		const auto size = node_size();
+		_plan = make_execution_plan<weight_type>(
+			size,
+			_connection_list,
+			[size](node_id_type id) {
+				return (id < size) ? id : plan_type::npos;
+			}
+		);
+		_segments = make_activation_segments(_plan, [this](typename plan_type::slot_type slot) { return _activation_types[slot]; });
+		_compiled = true;
+	}
+
+	bool compiled() const { return _compiled; }
+
+	void invalidate() { _compiled = false; }
+
+	const plan_type &plan() const { return _plan; }
+
+protected:
+	void resize(std::size_t size) {
+		_values.resize(size);
+		_activation_types.resize(size, _default_activation.type);
+		_activation_parameters.resize(size, _default_activation.parameter);
+		resize_extras(size, std::index_sequence_for<Extras...>());
+	}
+
+	template <std::size_t... Indices>
+	void resize_extras(std::size_t size, std::index_sequence<Indices...>) {
+		using expander = int[];
+		(void)expander {
+			0, ((void)std::get<Indices>(_extras).resize(size), 0)...
+		};
+		(void)size;
+	}
+
+	template <std::size_t... Indices>
+	void assign_extras(node_id_type id, std::index_sequence<Indices...>, Extras&&... extras) {
+		using expander = int[];
+		(void)expander {
+			0, ((void)(std::get<Indices>(_extras)[id] = std::move(extras)), 0)...
+		};
+		(void)id;
+	}
+
+	void process_tile(
+		const layer_type &in,
+		const layer_type &out,
+		const value_type *inputs,
+		value_type *outputs,
+		std::size_t count,
+		value_list_type &values
+	) const {
+		constexpr auto tile = batch_tile_size();
+		std::fill(values.begin(), values.end(), value_type());
+		for (std::size_t sample = 0; sample < count; ++sample) {
+			for (std::size_t k = 0; k < in.size(); ++k) {
+				values[(in.first + k) * tile + sample] = inputs[sample * in.size() + k];
+			}
+		}
+
+		const auto &plan = _plan;
+		for (std::size_t i = 0; i < plan.order.size(); ++i) {
+			const auto slot = plan.order[i];
+			auto *sums = values.data() + slot * tile;
+
+			for (auto edge = plan.offsets[i]; edge < plan.offsets[i + 1]; ++edge) {
+				const auto *x = values.data() + plan.inputs[edge] * tile;
+				const auto weight = plan.weights[edge];
+				for (std::size_t sample = 0; sample < count; ++sample) {
+					sums[sample] += x[sample] * weight;
+				}
+			}
+			const auto type = _activation_types[slot];
+			if (type == activation_type::custom) {
+				for (std::size_t sample = 0; sample < count; ++sample) {
+					sums[sample] = activation(sums[sample], slot);
+				}
+
+			} else {
+				detail::apply_activation(type, sums, count, &_activation_parameters[slot], 0);
+			}
+		}
+
+		for (std::size_t sample = 0; sample < count; ++sample) {
+			for (std::size_t k = 0; k < out.size(); ++k) {
+				outputs[sample * out.size() + k] = values[(out.first + k) * tile + sample];
+			}
+		}
+	}
+
+	value_type activation(value_type value, node_id_type id) const {
+		const auto type = _activation_types[id];
+		if (type != activation_type::custom) {
+			return detail::activate(type, value, _activation_parameters[id]);
+		}
+		return _activation_function ? _activation_function(value, id) : value;
+	}
+
+private:
+	value_list_type _values;
+	extras_type _extras;
+	layer_map_type _layer_map;
+	connection_list_type _connection_list;
+	activation_function_type _activation_function;
+	builtin_activation_type _default_activation;
+	std::vector<activation_type> _activation_types;
+	value_list_type _activation_parameters;
+
+	plan_type _plan;
+	std::vector<activation_segment> _segments;
+	bool _compiled = false;
+};
+
+using packed_network = basic_packed_network<>;
+
+} // namespace neural_network
+
+#endif // NEURAL_NETWORK_PACKED_NETWORK_HPP_
@@ -0,0 +1,138 @@
+
+#ifndef NEURAL_NETWORK_PLAN_HPP_
+#define NEURAL_NETWORK_PLAN_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <queue>
+#include <utility>
+#include <functional>
+
+namespace neural_network {
+
+// a forward pass as flat arrays; slots index the node storage of the
+// network, the inputs of order[i] are in [offsets[i], offsets[i + 1])
+template <class Weight = float>
+struct execution_plan {
+	using slot_type = std::size_t;
+	using weight_type = Weight;
+
+	static constexpr slot_type npos = static_cast<slot_type>(-1);
+
+	std::vector<slot_type> order;
+	std::vector<std::size_t> offsets;
+	std::vector<slot_type> inputs;
+	std::vector<weight_type> weights;
+
+	// index in the connection list of every input
+	std::vector<std::size_t> connections;
+
+	void clear() {
+		order.clear();
+		offsets.clear();
+		inputs.clear();
+		weights.clear();
+		connections.clear();
+	}
+};
+
+// sorts the out nodes of connections topologically (Kahn's algorithm) and
+// groups their inputs in connection order; ties and cycles fall back to the
+// order in which the out nodes first appear
+// find_slot(node id) returns a slot below node_size, or npos to leave the
+// connection out
+template <class Weight, class Connections, class FindSlot>
+execution_plan<Weight> make_execution_plan(std::size_t node_size, const Connections &connections, FindSlot &&find_slot) {
+	using plan_type = execution_plan<Weight>;
+	using slot_type = typename plan_type::slot_type;
+	constexpr auto npos = plan_type::npos;
+
+	plan_type plan;
+
+	constexpr auto unranked = static_cast<std::size_t>(-1);
+	std::vector<std::size_t> rank(node_size, unranked);
+	std::vector<slot_type> outs;
+	std::vector<std::pair<slot_type, slot_type>> edges(connections.size(), { npos, npos });
+	for (std::size_t index = 0; index < connections.size(); ++index) {
+		const auto &connection = connections[index];
+		const slot_type in = find_slot(connection.in());
+		const slot_type out = find_slot(connection.out());
+		if ((in == npos) || (out == npos)) continue;
+
+		edges[index] = { in, out };
+		if (rank[out] == unranked) {
+			rank[out] = outs.size();
+			outs.push_back(out);
+		}
+	}
+
+	// inputs grouped by out node, in connection order
+	std::vector<std::size_t> first(outs.size() + 1, 0);
+	for (const auto &edge : edges) {
+		if (edge.second != npos) ++first[rank[edge.second] + 1];
+	}
+	for (std::size_t i = 0; i < outs.size(); ++i) {
+		first[i + 1] += first[i];
+	}
+	std::vector<std::size_t> grouped(first.back());
+	{
+		auto next = first;
+		for (std::size_t index = 0; index < edges.size(); ++index) {
+			if (edges[index].second != npos) grouped[next[rank[edges[index].second]]++] = index;
+		}
+	}
+
+	// a self loop is not a dependency
+	std::vector<std::size_t> pending(outs.size(), 0);
+	std::vector<std::vector<std::size_t>> dependents(outs.size());
+	for (const auto &edge : edges) {
+		if ((edge.second == npos) || (edge.first == edge.second) || (rank[edge.first] == unranked)) continue;
+		++pending[rank[edge.second]];
+		dependents[rank[edge.first]].push_back(rank[edge.second]);
+	}
+
+	std::priority_queue<std::size_t, std::vector<std::size_t>, std::greater<std::size_t>> ready;
+	for (std::size_t i = 0; i < outs.size(); ++i) {
+		if (pending[i] == 0) ready.push(i);
+	}
+
+	std::vector<bool> done(outs.size(), false);
+	std::size_t next_cycle = 0;
+	plan.order.reserve(outs.size());
+	plan.offsets.reserve(outs.size() + 1);
+	plan.offsets.push_back(0);
+	plan.inputs.reserve(grouped.size());
+	plan.weights.reserve(grouped.size());
+	plan.connections.reserve(grouped.size());
+	while (plan.order.size() < outs.size()) {
+		if (ready.empty()) {
+			// a cycle; its earliest node goes first
+			while (done[next_cycle]) ++next_cycle;
+			ready.push(next_cycle);
+		}
+
+		const auto i = ready.top();
+		ready.pop();
+		if (done[i]) continue;
+		done[i] = true;
+
+		plan.order.push_back(outs[i]);
+		for (auto k = first[i]; k < first[i + 1]; ++k) {
+			const auto index = grouped[k];
+			plan.inputs.push_back(edges[index].first);
+			plan.weights.push_back(static_cast<Weight>(connections[index].weight()));
+			plan.connections.push_back(index);
+		}
+		plan.offsets.push_back(plan.inputs.size());
+
+		for (auto dependent : dependents[i]) {
+			if (!done[dependent] && (--pending[dependent] == 0)) ready.push(dependent);
+		}
+	}
+
+	return plan;
+}
+
+} // namespace neural_network
+
+#endif // NEURAL_NETWORK_PLAN_HPP_
@@ -0,0 +1,47 @@
+
+#ifndef UTILITY_ALIGNED_ALLOCATOR_HPP_
+#define UTILITY_ALIGNED_ALLOCATOR_HPP_
+
+#include <cstddef>
+#include <new>
+
+namespace utility {
+
+// std::allocator whose blocks start on an Alignment boundary, e.g. for
+// aligned SIMD loads from a std::vector
+template <class T, std::size_t Alignment = 64>
+class aligned_allocator {
+public:
+	using value_type = T;
+
+	static constexpr std::size_t alignment = (Alignment < alignof(T)) ? alignof(T) : Alignment;
+
+	template <class U>
+	struct rebind {
+		using other = aligned_allocator<U, Alignment>;
+	};
+
+public:
+	aligned_allocator() noexcept {}
+
+	template <class U>
+	aligned_allocator(const aligned_allocator<U, Alignment> &) noexcept {}
+
+	T *allocate(std::size_t size) {
+		return static_cast<T *>(::operator new(size * sizeof(T), std::align_val_t(alignment)));
+	}
+
+	void deallocate(T *pointer, std::size_t) noexcept {
+		::operator delete(pointer, std::align_val_t(alignment));
+	}
+
+	template <class U>
+	bool operator ==(const aligned_allocator<U, Alignment> &) const noexcept { return true; }
+
+	template <class U>
+	bool operator !=(const aligned_allocator<U, Alignment> &) const noexcept { return false; }
+};
+
+} // namespace utility
+
+#endif // UTILITY_ALIGNED_ALLOCATOR_HPP_
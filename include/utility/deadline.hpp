@@ -0,0 +1,50 @@
+
+#ifndef UTILITY_DEADLINE_HPP_
+#define UTILITY_DEADLINE_HPP_
+
+#include <chrono>
+
+namespace utility {
+
+// time budget for work that is spread over several frames
+// the clock is read once every check_interval calls of expired(), so a
+// caller always gets that much work done; once expired it stays expired
+class deadline {
+public:
+	using clock_type = std::chrono::steady_clock;
+	using duration_type = std::chrono::nanoseconds;
+
+	static constexpr duration_type unlimited() { return duration_type::max(); }
+
+public:
+	explicit deadline(duration_type budget = unlimited(), unsigned int check_interval = 32)
+		: _limited(budget != unlimited()), _check_interval((check_interval > 0) ? check_interval : 1) {
+		if (_limited) {
+			_end = clock_type::now() + budget;
+		}
+	}
+
+	bool limited() const { return _limited; }
+
+	bool expired() {
+		if (_expired) return true;
+		if (!_limited) return false;
+
+		if (++_count < _check_interval) return false;
+		_count = 0;
+
+		_expired = (clock_type::now() >= _end);
+		return _expired;
+	}
+
+private:
+	bool _limited;
+	bool _expired = false;
+	unsigned int _check_interval;
+	unsigned int _count = 0;
+	clock_type::time_point _end;
+};
+
+} // namespace utility
+
+#endif // UTILITY_DEADLINE_HPP_
@@ -0,0 +1,101 @@
+
+#ifndef UTILITY_GENERATIONAL_ID_POOL_HPP_
+#define UTILITY_GENERATIONAL_ID_POOL_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <limits>
+#include <utility>
+
+#include "id_pool.hpp"
+
+namespace utility {
+
+// id = generation << IndexBits | index
+// the generation of each index lives in a flat array, so a stale id is
+// detected with a single compare
+template <class T = unsigned int, std::size_t IndexBits = sizeof(T) * 6>
+class generational_id_pool {
+public:
+	using id_type = T;
+	using index_type = T;
+	using generation_type = T;
+	using generation_list = std::vector<generation_type>;
+
+	static constexpr std::size_t index_bits = IndexBits;
+	static constexpr std::size_t generation_bits = sizeof(id_type) * 8 - index_bits;
+
+	static constexpr index_type index_mask = (static_cast<id_type>(1) << index_bits) - 1;
+	static constexpr generation_type generation_mask = (static_cast<id_type>(1) << generation_bits) - 1;
+
+	static constexpr id_type invalid_id = std::numeric_limits<id_type>::max();
+
+	// index_mask itself is the "pool exhausted" marker and never handed out
+	using index_pool = id_pool<index_type, 0, index_mask>;
+
+	static constexpr index_type index(id_type id) { return id & index_mask; }
+	static constexpr generation_type generation(id_type id) { return (id >> index_bits) & generation_mask; }
+	static constexpr id_type make_id(index_type index, generation_type generation) {
+		return ((generation & generation_mask) << index_bits) | (index & index_mask);
+	}
+
+public:
+	generational_id_pool() = default;
+
+	id_type allocate() {
+		const auto i = _index_pool.allocate();
+		if (i == index_mask) return invalid_id;
+
+		if (i >= _generations.size()) {
+			_generations.resize(i + 1, 0);
+		}
+		return make_id(i, _generations[i]);
+	}
+
+	bool free(id_type id) {
+		if (!valid(id)) return false;
+
+		const auto i = index(id);
+		_generations[i] = (_generations[i] + 1) & generation_mask;
+		_index_pool.free(i);
+		return true;
+	}
+
+	bool valid(id_type id) const {
+		const auto i = index(id);
+		return (i < _generations.size()) && (_generations[i] == generation(id));
+	}
+
+	void clear() {
+		// keep the generations so ids issued before clear() stay stale
+		for (auto &generation : _generations) {
+			generation = (generation + 1) & generation_mask;
+		}
+		_index_pool.clear();
+	}
+
+	void reserve(std::size_t size) {
+		_generations.reserve(size);
+	}
+
+	const generation_list &generations() const { return _generations; }
+
+	const index_pool &indices() const { return _index_pool; }
+
+	// freed indices waiting for reuse
+	std::size_t free_size() const { return _index_pool.free_size(); }
+
+	// restores a saved state
+	void assign(generation_list generations, index_pool indices) {
+		_generations = std::move(generations);
+		_index_pool = std::move(indices);
+	}
+
+private:
+	index_pool _index_pool;
+	generation_list _generations;
+};
+
+} // namespace utility
+
+#endif // UTILITY_GENERATIONAL_ID_POOL_HPP_
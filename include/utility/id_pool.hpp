@@ -2,17 +2,25 @@
 #ifndef UTILITY_ID_POOL_HPP_
 #define UTILITY_ID_POOL_HPP_
 
+#include <cstddef>
 #include <deque>
+#include <vector>
+#include <utility>
 #include <limits>
 #include <algorithm>
+#include <functional>
+#include <type_traits>
 
 namespace utility {
 
-template <class T = unsigned int, T Min = std::numeric_limits<T>::min(), T Max = std::numeric_limits<T>::max()>
+// freed ids are handed out again last freed first, or lowest first when
+// LowestFirst is set; the free list is then a heap, O(log n) per free and
+// allocate
+template <class T = unsigned int, T Min = std::numeric_limits<T>::min(), T Max = std::numeric_limits<T>::max(), bool LowestFirst = false>
 class id_pool {
 public:
 	using id_type = T;
-	using free_id_container = std::deque<id_type>;
+	using free_id_container = std::conditional_t<LowestFirst, std::vector<id_type>, std::deque<id_type>>;
 
 	static constexpr id_type min_id = Min;
 	static constexpr id_type max_id = Max;
@@ -22,11 +30,14 @@ public:
 	id_type allocate() {
 		id_type id = max_id;
 
-		if (!_free_ids.empty()) {
-			id = _free_ids.back();
-			_free_ids.pop_back();
+		// ids given up by shrink() are passed over
+		while (!_free_ids.empty()) {
+			id = take_free_id();
+			if (id < _current_id) return id;
+			--_dropped;
+		}
 
-		} else if (_current_id == max_id) {
+		if (_current_id == max_id) {
 			id = max_id;
 
 		} else {
@@ -37,22 +48,84 @@ public:
 		return id;
 	}
 
+	// count consecutive new ids, the free list is left alone
+	id_type allocate_range(id_type count) {
+		if ((max_id - _current_id) < count) return max_id;
+
+		id_type id = _current_id;
+		_current_id += count;
+		return id;
+	}
+
 	void free(const id_type &id) {
 		_free_ids.push_back(id);
+		if constexpr (LowestFirst) {
+			std::push_heap(_free_ids.begin(), _free_ids.end(), std::greater<id_type>());
+		}
 	}
 
 	void free(id_type &&id) {
-		_free_ids.push_back(id);
+		free(static_cast<const id_type &>(id));
+	}
+
+	// lowers current_id after the caller gave up every id at or past it;
+	// dropped of those are still in the free list and stay there, uncounted,
+	// until allocate() reaches them
+	void shrink(id_type current_id, std::size_t dropped) {
+		_current_id = current_id;
+		_dropped += dropped;
+		if (_dropped == _free_ids.size()) {
+			_free_ids.clear();
+			_dropped = 0;
+		}
 	}
 
 	void clear() {
 		_free_ids.clear();
+		_dropped = 0;
 		_current_id = min_id;
 	}
 
+	// next new id; every id below it was handed out at least once
+	id_type current_id() const { return _current_id; }
+
+	// in no particular order when LowestFirst is set; may still hold ids
+	// that shrink() gave up
+	const free_id_container &free_ids() const { return _free_ids; }
+
+	// ids allocate() hands out before new ones
+	std::size_t free_size() const { return _free_ids.size() - _dropped; }
+
+	// restores a saved state
+	void assign(id_type current_id, free_id_container free_ids) {
+		_current_id = current_id;
+		_free_ids = std::move(free_ids);
+		if constexpr (LowestFirst) {
+			std::make_heap(_free_ids.begin(), _free_ids.end(), std::greater<id_type>());
+		}
+		_dropped = static_cast<std::size_t>(std::count_if(
+			_free_ids.begin(),
+			_free_ids.end(),
+			[&](const id_type &id) {
+				return id >= _current_id;
+			}
+		));
+	}
+
+private:
+	id_type take_free_id() {
+		if constexpr (LowestFirst) {
+			std::pop_heap(_free_ids.begin(), _free_ids.end(), std::greater<id_type>());
+		}
+		const auto id = _free_ids.back();
+		_free_ids.pop_back();
+		return id;
+	}
+
 private:
 	id_type _current_id = min_id;
 	free_id_container _free_ids;
+	std::size_t _dropped = 0;
 };
 
 } // namespace utility
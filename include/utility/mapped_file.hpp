@@ -0,0 +1,139 @@
+
+#ifndef UTILITY_MAPPED_FILE_HPP_
+#define UTILITY_MAPPED_FILE_HPP_
+
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utility {
+
+// read-only memory mapping of a whole file
+// the mapping starts on a page boundary, so aligned offsets in the file are
+// aligned in memory too
+class mapped_file {
+public:
+	mapped_file() {}
+
+	explicit mapped_file(const std::string &path) {
+		open(path);
+	}
+
+	mapped_file(const mapped_file &) = delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	mapped_file(mapped_file &&other) noexcept {
+		swap(other);
+	}
+
+	mapped_file &operator=(mapped_file &&other) noexcept {
+		if (this != &other) {
+			close();
+			swap(other);
+		}
+		return *this;
+	}
+
+	~mapped_file() {
+		close();
+	}
+
+	void swap(mapped_file &other) noexcept {
+		std::swap(_data, other._data);
+		std::swap(_size, other._size);
+	}
+
+	const unsigned char *data() const { return static_cast<const unsigned char *>(_data); }
+
+	std::size_t size() const { return _size; }
+
+	bool is_open() const { return _data != nullptr; }
+
+	// throws std::runtime_error when the file cannot be mapped
+	void open(const std::string &path) {
+		close();
+
+#if defined(_WIN32)
+		HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("utility::mapped_file: cannot open " + path);
+		}
+
+		LARGE_INTEGER size;
+		if (!::GetFileSizeEx(file, &size) || (size.QuadPart == 0)) {
+			::CloseHandle(file);
+			throw std::runtime_error("utility::mapped_file: empty file " + path);
+		}
+
+		HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		::CloseHandle(file);
+		if (mapping == nullptr) {
+			throw std::runtime_error("utility::mapped_file: cannot map " + path);
+		}
+
+		// the view keeps the mapping alive
+		_data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		::CloseHandle(mapping);
+		if (_data == nullptr) {
+			throw std::runtime_error("utility::mapped_file: cannot map " + path);
+		}
+		_size = static_cast<std::size_t>(size.QuadPart);
+
+#else
+		const int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			throw std::runtime_error("utility::mapped_file: cannot open " + path);
+		}
+
+		struct stat status;
+		if ((::fstat(file, &status) != 0) || (status.st_size == 0)) {
+			::close(file);
+			throw std::runtime_error("utility::mapped_file: empty file " + path);
+		}
+
+		void *data = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file);
+		if (data == MAP_FAILED) {
+			throw std::runtime_error("utility::mapped_file: cannot map " + path);
+		}
+		_data = data;
+		_size = static_cast<std::size_t>(status.st_size);
+#endif
+	}
+
+	void close() {
+		if (_data == nullptr) return;
+
+#if defined(_WIN32)
+		::UnmapViewOfFile(_data);
+#else
+		::munmap(_data, _size);
+#endif
+		_data = nullptr;
+		_size = 0;
+	}
+
+private:
+	void *_data = nullptr;
+	std::size_t _size = 0;
+};
+
+} // namespace utility
+
+#endif // UTILITY_MAPPED_FILE_HPP_
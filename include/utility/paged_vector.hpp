@@ -0,0 +1,341 @@
+
+#ifndef UTILITY_PAGED_VECTOR_HPP_
+#define UTILITY_PAGED_VECTOR_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+
+namespace utility {
+
+// vector-like container made of fixed size, aligned pages
+// growing never moves existing elements, so references and pointers stay
+// valid until the element is erased
+// the page pointers live in a two-level directory: its top level is sized
+// from MaxSize and allocated once, blocks of page pointers are added as the
+// vector grows, and neither ever moves
+// so one thread may grow the vector (reserve(), push_back(), emplace_back(),
+// a growing resize()) while others use operator[] on elements that existed
+// before; size(), page(), iterators and every other member still need the
+// caller's synchronization
+// each page is contiguous and can be walked as a plain array through page()
+// holds at most MaxSize elements, growing past it throws std::length_error
+template <class T, std::size_t PageBytes = 16 * 1024, std::size_t Alignment = 64, std::size_t MaxSize = (std::size_t(1) << 24)>
+class paged_vector {
+public:
+	using value_type = T;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using reference = T &;
+	using const_reference = const T &;
+	using pointer = T *;
+	using const_pointer = const T *;
+
+	static constexpr size_type floor_power_of_two(size_type n) {
+		size_type result = 1;
+		while ((result * 2) <= n) {
+			result *= 2;
+		}
+		return result;
+	}
+
+	// elements per page, a power of two
+	static constexpr size_type page_size = floor_power_of_two(std::max<size_type>(PageBytes / sizeof(T), 1));
+	static constexpr size_type page_mask = page_size - 1;
+	static constexpr size_type page_alignment = std::max(Alignment, alignof(T));
+
+	// page pointers per directory block, a power of two
+	static constexpr size_type block_size = 512;
+	static constexpr size_type block_mask = block_size - 1;
+	static constexpr size_type max_pages = (MaxSize + page_mask) / page_size;
+	static constexpr size_type directory_size = (max_pages + block_mask) / block_size;
+
+	template <class U>
+	struct basic_span {
+		U *first;
+		size_type count;
+
+		U *data() const { return first; }
+		size_type size() const { return count; }
+		bool empty() const { return count == 0; }
+		U *begin() const { return first; }
+		U *end() const { return first + count; }
+		U &operator[](size_type index) const { return first[index]; }
+	};
+
+	using span = basic_span<T>;
+	using const_span = basic_span<const T>;
+
+	template <class Container, class U>
+	class basic_iterator {
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = U *;
+		using reference = U &;
+
+	public:
+		basic_iterator() : _container(nullptr), _index(0) {}
+		basic_iterator(Container *container, size_type index) : _container(container), _index(index) {}
+
+		template <class OtherContainer, class OtherU>
+		basic_iterator(const basic_iterator<OtherContainer, OtherU> &other) : _container(other.container()), _index(other.index()) {}
+
+		Container *container() const { return _container; }
+		size_type index() const { return _index; }
+
+		reference operator*() const { return (*_container)[_index]; }
+		pointer operator->() const { return &(*_container)[_index]; }
+		reference operator[](difference_type n) const { return (*_container)[_index + n]; }
+
+		basic_iterator &operator++() { ++_index; return *this; }
+		basic_iterator &operator--() { --_index; return *this; }
+		basic_iterator operator++(int) { auto it = *this; ++_index; return it; }
+		basic_iterator operator--(int) { auto it = *this; --_index; return it; }
+
+		basic_iterator &operator+=(difference_type n) { _index += n; return *this; }
+		basic_iterator &operator-=(difference_type n) { _index -= n; return *this; }
+		basic_iterator operator+(difference_type n) const { return basic_iterator(_container, _index + n); }
+		basic_iterator operator-(difference_type n) const { return basic_iterator(_container, _index - n); }
+		friend basic_iterator operator+(difference_type n, const basic_iterator &it) { return it + n; }
+
+		difference_type operator-(const basic_iterator &other) const {
+			return static_cast<difference_type>(_index) - static_cast<difference_type>(other._index);
+		}
+
+		bool operator==(const basic_iterator &other) const { return _index == other._index; }
+		bool operator!=(const basic_iterator &other) const { return _index != other._index; }
+		bool operator<(const basic_iterator &other) const { return _index < other._index; }
+		bool operator>(const basic_iterator &other) const { return _index > other._index; }
+		bool operator<=(const basic_iterator &other) const { return _index <= other._index; }
+		bool operator>=(const basic_iterator &other) const { return _index >= other._index; }
+
+	private:
+		Container *_container;
+		size_type _index;
+	};
+
+	using iterator = basic_iterator<paged_vector, T>;
+	using const_iterator = basic_iterator<const paged_vector, const T>;
+
+public:
+	paged_vector() {}
+
+	paged_vector(const paged_vector &other) {
+		reserve(other.size());
+		for (const auto &value : other) {
+			push_back(value);
+		}
+	}
+
+	paged_vector(paged_vector &&other) noexcept
+		: _directory(std::move(other._directory)), _allocated_pages(other._allocated_pages), _size(other._size) {
+		other._allocated_pages = 0;
+		other._size = 0;
+	}
+
+	~paged_vector() {
+		clear();
+		release_pages(0);
+	}
+
+	paged_vector &operator=(const paged_vector &other) {
+		if (this != &other) {
+			paged_vector copy(other);
+			swap(copy);
+		}
+		return *this;
+	}
+
+	paged_vector &operator=(paged_vector &&other) noexcept {
+		if (this != &other) {
+			clear();
+			release_pages(0);
+			swap(other);
+		}
+		return *this;
+	}
+
+	void swap(paged_vector &other) noexcept {
+		_directory.swap(other._directory);
+		std::swap(_allocated_pages, other._allocated_pages);
+		std::swap(_size, other._size);
+	}
+
+	size_type size() const { return _size; }
+
+	bool empty() const { return _size == 0; }
+
+	size_type capacity() const { return _allocated_pages * page_size; }
+
+	size_type max_size() const { return MaxSize; }
+
+	size_type page_count() const { return (_size + page_mask) / page_size; }
+
+	// the live elements of page p
+	span page(size_type p) {
+		return { page_address(p), std::min(page_size, _size - p * page_size) };
+	}
+
+	const_span page(size_type p) const {
+		return { page_address(p), std::min(page_size, _size - p * page_size) };
+	}
+
+	reference operator[](size_type index) { return page_address(index / page_size)[index & page_mask]; }
+	const_reference operator[](size_type index) const { return page_address(index / page_size)[index & page_mask]; }
+
+	reference at(size_type index) {
+		if (index >= _size) throw std::out_of_range("utility::paged_vector::at");
+		return (*this)[index];
+	}
+
+	const_reference at(size_type index) const {
+		if (index >= _size) throw std::out_of_range("utility::paged_vector::at");
+		return (*this)[index];
+	}
+
+	reference front() { return (*this)[0]; }
+	const_reference front() const { return (*this)[0]; }
+
+	reference back() { return (*this)[_size - 1]; }
+	const_reference back() const { return (*this)[_size - 1]; }
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, _size); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, _size); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	// only adds pages; existing pages and directory blocks stay where they are
+	void reserve(size_type size) {
+		if (size > MaxSize) {
+			throw std::length_error("utility::paged_vector::reserve");
+		}
+
+		const auto pages = (size + page_mask) / page_size;
+		if ((pages > 0) && !_directory) {
+			_directory.reset(new block_type[directory_size]);
+		}
+		while (_allocated_pages < pages) {
+			auto &block = _directory[_allocated_pages / block_size];
+			if (!block) {
+				block.reset(new T *[block_size]);
+			}
+			block[_allocated_pages & block_mask] = allocate_page();
+			++_allocated_pages;
+		}
+	}
+
+	void resize(size_type size) {
+		reserve(size);
+		while (_size < size) {
+			new (address(_size)) T();
+			++_size;
+		}
+		while (_size > size) {
+			pop_back();
+		}
+	}
+
+	void resize(size_type size, const T &value) {
+		reserve(size);
+		while (_size < size) {
+			new (address(_size)) T(value);
+			++_size;
+		}
+		while (_size > size) {
+			pop_back();
+		}
+	}
+
+	template <class... Args>
+	reference emplace_back(Args&&... args) {
+		reserve(_size + 1);
+		auto *p = new (address(_size)) T(std::forward<Args>(args)...);
+		++_size;
+		return *p;
+	}
+
+	void push_back(const T &value) {
+		emplace_back(value);
+	}
+
+	void push_back(T &&value) {
+		emplace_back(std::move(value));
+	}
+
+	void pop_back() {
+		--_size;
+		address(_size)->~T();
+	}
+
+	// appends [first, last) and rotates it into place
+	template <class InputIterator>
+	iterator insert(const_iterator position, InputIterator first, InputIterator last) {
+		const auto offset = position.index();
+		const auto old_size = _size;
+		for (; first != last; ++first) {
+			emplace_back(*first);
+		}
+		std::rotate(begin() + offset, begin() + old_size, end());
+		return begin() + offset;
+	}
+
+	// destroys the elements, the pages are kept for reuse
+	void clear() {
+		while (_size > 0) {
+			pop_back();
+		}
+	}
+
+	void shrink_to_fit() {
+		release_pages(page_count());
+	}
+
+protected:
+	using block_type = std::unique_ptr<T *[]>;
+
+	T *page_address(size_type p) const {
+		return _directory[p / block_size][p & block_mask];
+	}
+
+	T *address(size_type index) {
+		return page_address(index / page_size) + (index & page_mask);
+	}
+
+	static T *allocate_page() {
+		return static_cast<T *>(::operator new(page_size * sizeof(T), std::align_val_t(page_alignment)));
+	}
+
+	static void deallocate_page(T *page) {
+		::operator delete(page, std::align_val_t(page_alignment));
+	}
+
+	void release_pages(size_type keep) {
+		while (_allocated_pages > keep) {
+			--_allocated_pages;
+			deallocate_page(page_address(_allocated_pages));
+
+			// the first page of a block takes the block with it
+			if ((_allocated_pages & block_mask) == 0) {
+				_directory[_allocated_pages / block_size].reset();
+			}
+		}
+	}
+
+private:
+	std::unique_ptr<block_type[]> _directory;
+	size_type _allocated_pages = 0;
+
+	size_type _size = 0;
+};
+
+} // namespace utility
+
+#endif // UTILITY_PAGED_VECTOR_HPP_
@@ -0,0 +1,54 @@
+
+#ifndef UTILITY_SPAN_HPP_
+#define UTILITY_SPAN_HPP_
+
+#include <cstddef>
+#include <type_traits>
+
+namespace utility {
+
+// a non-owning view of contiguous values, until std::span is available
+template <class T>
+class span {
+public:
+	using element_type = T;
+	using value_type = std::remove_cv_t<T>;
+	using size_type = std::size_t;
+	using pointer = T *;
+	using reference = T &;
+	using iterator = T *;
+
+public:
+	constexpr span() : _data(nullptr), _size(0) {}
+
+	constexpr span(pointer data, size_type size) : _data(data), _size(size) {}
+
+	// any container with data() and size(), e.g. std::vector
+	template <class Container, class = std::enable_if_t<std::is_convertible_v<decltype(std::declval<Container &>().data()), pointer>>>
+	constexpr span(Container &container) : _data(container.data()), _size(container.size()) {}
+
+	// span<T> to span<const T>
+	template <class U, class = std::enable_if_t<std::is_convertible_v<U *, pointer>>>
+	constexpr span(const span<U> &other) : _data(other.data()), _size(other.size()) {}
+
+	constexpr pointer data() const { return _data; }
+	constexpr size_type size() const { return _size; }
+	constexpr bool empty() const { return _size == 0; }
+
+	constexpr iterator begin() const { return _data; }
+	constexpr iterator end() const { return _data + _size; }
+
+	constexpr reference operator [](size_type index) const { return _data[index]; }
+
+	constexpr span subspan(size_type offset, size_type count) const {
+		return span(_data + offset, count);
+	}
+
+private:
+	pointer _data;
+	size_type _size;
+};
+
+} // namespace utility
+
+#endif // UTILITY_SPAN_HPP_
@@ -0,0 +1,191 @@
+
+#ifndef UTILITY_THREAD_POOL_HPP_
+#define UTILITY_THREAD_POOL_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <type_traits>
+#include <algorithm>
+
+namespace utility {
+
+// persistent worker threads, one task queue per worker
+// idle workers steal from the front of the other queues
+class thread_pool {
+public:
+	using task_type = std::function<void()>;
+
+	static std::size_t default_size() {
+		const auto concurrency = static_cast<std::size_t>(std::thread::hardware_concurrency());
+		return (concurrency > 1) ? (concurrency - 1) : 1;
+	}
+
+	// shared pool; the calling thread joins in while it waits, so this
+	// uses hardware_concurrency() threads in total
+	static thread_pool &shared() {
+		static thread_pool pool;
+		return pool;
+	}
+
+public:
+	explicit thread_pool(std::size_t size = default_size()) {
+		size = std::max<std::size_t>(size, 1);
+
+		_queues.reserve(size);
+		for (std::size_t i = 0; i < size; ++i) {
+			_queues.emplace_back(new queue);
+		}
+
+		_threads.reserve(size);
+		for (std::size_t i = 0; i < size; ++i) {
+			_threads.emplace_back([this, i] { work(i); });
+		}
+	}
+
+	thread_pool(const thread_pool &) = delete;
+	thread_pool &operator=(const thread_pool &) = delete;
+
+	~thread_pool() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_condition.notify_all();
+
+		for (auto &thread : _threads) {
+			thread.join();
+		}
+	}
+
+	std::size_t size() const { return _threads.size(); }
+
+	void push(task_type task) {
+		const auto index = _next.fetch_add(1, std::memory_order_relaxed) % _queues.size();
+		{
+			std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+			_queues[index]->tasks.emplace_back(std::move(task));
+
+			// under the queue lock, so a steal cannot decrement it first
+			_pending.fetch_add(1, std::memory_order_release);
+		}
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+		}
+		_condition.notify_one();
+	}
+
+	template <class F>
+	decltype(auto) submit(F &&fn) {
+		using result_type = std::invoke_result_t<std::decay_t<F>>;
+
+		auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(fn));
+		auto future = task->get_future();
+		push([task] { (*task)(); });
+		return future;
+	}
+
+	// runs one queued task on the calling thread, if there is any
+	bool run_pending_task() {
+		task_type task;
+		if (!steal(0, task)) return false;
+		task();
+		return true;
+	}
+
+	// fn(chunk_begin, chunk_end) over [begin, end) in chunks of grain
+	template <class F>
+	void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F &&fn) {
+		if (begin >= end) return;
+
+		grain = std::max<std::size_t>(grain, 1);
+		const auto chunks = (end - begin + grain - 1) / grain;
+		if (chunks == 1) {
+			fn(begin, end);
+			return;
+		}
+
+		std::atomic<std::size_t> remaining(chunks);
+		for (std::size_t chunk = 1; chunk < chunks; ++chunk) {
+			const auto chunk_begin = begin + chunk * grain;
+			const auto chunk_end = std::min(chunk_begin + grain, end);
+			push([&fn, &remaining, chunk_begin, chunk_end] {
+				fn(chunk_begin, chunk_end);
+				remaining.fetch_sub(1, std::memory_order_acq_rel);
+			});
+		}
+
+		// the first chunk runs here, then help with the rest
+		fn(begin, std::min(begin + grain, end));
+		remaining.fetch_sub(1, std::memory_order_acq_rel);
+
+		while (remaining.load(std::memory_order_acquire) > 0) {
+			if (!run_pending_task()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+protected:
+	struct queue {
+		std::mutex mutex;
+		std::deque<task_type> tasks;
+	};
+
+	bool pop(std::size_t index, task_type &task) {
+		auto &q = *_queues[index];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (q.tasks.empty()) return false;
+		task = std::move(q.tasks.back());
+		q.tasks.pop_back();
+		_pending.fetch_sub(1, std::memory_order_acq_rel);
+		return true;
+	}
+
+	bool steal(std::size_t index, task_type &task) {
+		for (std::size_t i = 0; i < _queues.size(); ++i) {
+			auto &q = *_queues[(index + i) % _queues.size()];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (q.tasks.empty()) continue;
+			task = std::move(q.tasks.front());
+			q.tasks.pop_front();
+			_pending.fetch_sub(1, std::memory_order_acq_rel);
+			return true;
+		}
+		return false;
+	}
+
+	void work(std::size_t index) {
+		while (true) {
+			task_type task;
+			if (pop(index, task) || steal(index + 1, task)) {
+				task();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this] { return _stop || (_pending.load(std::memory_order_acquire) > 0); });
+			if (_stop && (_pending.load(std::memory_order_acquire) == 0)) return;
+		}
+	}
+
+private:
+	std::vector<std::unique_ptr<queue>> _queues;
+	std::vector<std::thread> _threads;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::atomic<std::size_t> _pending { 0 };
+	std::atomic<std::size_t> _next { 0 };
+	bool _stop = false;
+};
+
+} // namespace utility
+
+#endif // UTILITY_THREAD_POOL_HPP_
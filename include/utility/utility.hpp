@@ -3,5 +3,11 @@
 #define UTILITY_HPP_
 
 #include "id_pool.hpp"
+#include "generational_id_pool.hpp"
+#include "thread_pool.hpp"
+#include "paged_vector.hpp"
+#include "deadline.hpp"
+#include "span.hpp"
+#include "aligned_allocator.hpp"
 
 #endif // UTILITY_HPP_